@@ -1,3 +1,5 @@
+if _TARGET_OS == "windows" then
+
 project "Opensegaapi"
 	targetname "Opensegaapi"
 	language "C++"
@@ -16,4 +18,44 @@ project "Opensegaapi"
 postbuildcommands {
   "if not exist $(TargetDir)output mkdir $(TargetDir)output",
   "{COPY} $(TargetDir)Opensegaapi.dll $(TargetDir)output/"
-}
\ No newline at end of file
+}
+
+else
+
+-- Platform-neutral core (buffer state, routing, mixing and the SEGAAPI_* entry points)
+-- as a shared object for running and profiling headless. Output goes to the null or
+-- WAV backend, platform.h stands in for the Win32 types.
+project "OpensegaapiCore"
+	targetname "Opensegaapi"
+	language "C++"
+	kind "SharedLib"
+
+	files
+	{
+		"src/**.cpp", "src/**.h"
+	}
+
+	removefiles { "src/backend_dsound.cpp" }
+
+	includedirs { "src" }
+
+end
+
+-- Checks of the core (SIMD kernels against scalar, loop seams and voice stealing through
+-- the mixer), built from the same sources. Exits non-zero when any of them fails.
+project "OpensegaapiTests"
+	targetname "OpensegaapiTests"
+	language "C++"
+	kind "ConsoleApp"
+
+	files
+	{
+		"tests/**.cpp", "tests/**.h",
+		"src/**.cpp", "src/**.h"
+	}
+
+	if _TARGET_OS ~= "windows" then
+		removefiles { "src/backend_dsound.cpp" }
+	end
+
+	includedirs { "src" }
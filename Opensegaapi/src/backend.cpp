@@ -0,0 +1,92 @@
+/*
+* This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+*
+* See LICENSE and MENTIONS in the root of the source tree for information
+* regarding licensing.
+*/
+#include "backend.h"
+#include "log.h"
+
+#include <chrono>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+
+bool PacedBackend::open(const OutputFormat& format, OutputPeriodCallback callback)
+{
+	if (m_thread.joinable())
+	{
+		info("PacedBackend: %s is already open", name());
+		return false;
+	}
+
+	m_format = format;
+	m_callback = callback;
+
+	if (!openSink())
+		return false;
+
+	m_running = true;
+	m_thread = std::thread(&PacedBackend::run, this);
+	return true;
+}
+
+unsigned int PacedBackend::latency() const
+{
+	return m_format.periodFrames;
+}
+
+void PacedBackend::close()
+{
+	if (m_running)
+	{
+		m_running = false;
+		m_thread.join();
+	}
+
+	closeSink();
+}
+
+void PacedBackend::run()
+{
+	std::vector<int16_t> period(m_format.periodFrames * m_format.channels);
+	auto periodLength = std::chrono::nanoseconds(1000000000ull * m_format.periodFrames / m_format.sampleRate);
+	auto deadline = std::chrono::steady_clock::now();
+
+	while (m_running)
+	{
+		m_callback(period.data(), m_format.periodFrames);
+		writePeriod(period.data(), m_format.periodFrames);
+
+		deadline += periodLength;
+		std::this_thread::sleep_until(deadline);
+	}
+}
+
+OutputBackend* createOutputBackend()
+{
+	const char* output = getenv("OPENSEGAAPI_OUTPUT");
+
+	if (output && strcmp(output, "null") == 0)
+		return createNullBackend();
+
+	if (output && strcmp(output, "offline") == 0)
+		return createOfflineBackend();
+
+	if (output && strcmp(output, "wav") == 0)
+	{
+		const char* path = getenv("OPENSEGAAPI_WAVFILE");
+		return createWavBackend(path ? path : "opensegaapi.wav");
+	}
+
+	if (output && strcmp(output, "dsound") != 0)
+	{
+		info("createOutputBackend: Unknown output %s, using the default", output);
+	}
+
+#ifdef _WIN32
+	return createDirectSoundBackend();
+#else
+	return createNullBackend();
+#endif
+}
@@ -0,0 +1,71 @@
+/*
+* This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+*
+* See LICENSE and MENTIONS in the root of the source tree for information
+* regarding licensing.
+*/
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+
+// Asked for the next period of interleaved 16-bit samples whenever the output needs one.
+typedef void(*OutputPeriodCallback)(int16_t* output, unsigned int frames);
+
+struct OutputFormat
+{
+	unsigned int sampleRate;
+	unsigned int channels;
+	unsigned int periodFrames;
+};
+
+class OutputBackend
+{
+public:
+	virtual ~OutputBackend() {}
+
+	virtual const char* name() const = 0;
+	virtual bool open(const OutputFormat& format, OutputPeriodCallback callback) = 0;
+	// Frames between a period being rendered and it reaching the output
+	virtual unsigned int latency() const = 0;
+	virtual void close() = 0;
+
+	// Pull-driven backends render on request and return the frames written,
+	// device-clocked ones return 0.
+	virtual unsigned int render(int16_t*, unsigned int) { return 0; }
+	virtual bool pullDriven() const { return false; }
+};
+
+// Drives the period callback from the system clock for sinks without a device clock.
+class PacedBackend : public OutputBackend
+{
+public:
+	bool open(const OutputFormat& format, OutputPeriodCallback callback) override;
+	unsigned int latency() const override;
+	void close() override;
+
+protected:
+	virtual bool openSink() { return true; }
+	virtual void writePeriod(const int16_t*, unsigned int) {}
+	virtual void closeSink() {}
+
+	OutputFormat m_format;
+
+private:
+	void run();
+
+	OutputPeriodCallback m_callback{nullptr};
+	std::thread m_thread;
+	std::atomic<bool> m_running{false};
+};
+
+OutputBackend* createDirectSoundBackend();
+OutputBackend* createNullBackend();
+OutputBackend* createWavBackend(const char* path);
+OutputBackend* createOfflineBackend();
+
+// Picks the backend named by OPENSEGAAPI_OUTPUT (dsound, null, wav or offline), defaulting to
+// DirectSound on Windows and null elsewhere. The WAV sink writes to
+// OPENSEGAAPI_WAVFILE, or opensegaapi.wav when that is not set.
+OutputBackend* createOutputBackend();
@@ -0,0 +1,221 @@
+/*
+* This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+*
+* See LICENSE and MENTIONS in the root of the source tree for information
+* regarding licensing.
+*/
+#include "backend.h"
+#include "log.h"
+
+#include <vector>
+#include <dsound.h>
+#include <mmreg.h>
+#include <ks.h>
+#include <ksmedia.h>
+#pragma comment(lib, "dsound.lib")
+#pragma comment(lib, "dxguid.lib")
+
+// Number of periods held by the DirectSound stream buffer
+#define STREAM_PERIODS 4
+
+// Feeds the one DirectSound buffer the device sees with mixer periods, staying
+// up to STREAM_PERIODS - 1 periods ahead of the play cursor.
+class DirectSoundBackend : public OutputBackend
+{
+public:
+	DirectSoundBackend()
+		: m_dsound(nullptr), m_stream(nullptr), m_callback(nullptr), m_running(false)
+	{
+	}
+
+	const char* name() const override { return "dsound"; }
+
+	bool open(const OutputFormat& format, OutputPeriodCallback callback) override
+	{
+		if (m_thread.joinable())
+		{
+			info("DirectSoundBackend: Already open");
+			return false;
+		}
+
+		m_format = format;
+		m_callback = callback;
+
+		CoInitialize(nullptr);
+
+		HRESULT hr = DirectSoundCreate8(NULL, &m_dsound, NULL);
+		if (FAILED(hr))
+		{
+			info("DirectSoundBackend: DirectSoundCreate8 failed: 0x%08x", hr);
+			return false;
+		}
+
+		hr = m_dsound->SetCooperativeLevel(GetDesktopWindow(), DSSCL_PRIORITY);
+		if (FAILED(hr))
+		{
+			info("DirectSoundBackend: SetCooperativeLevel failed: 0x%08x", hr);
+			close();
+			return false;
+		}
+
+		WAVEFORMATEXTENSIBLE waveFormat;
+		ZeroMemory(&waveFormat, sizeof(WAVEFORMATEXTENSIBLE));
+		waveFormat.Format.wFormatTag = WAVE_FORMAT_PCM;
+		waveFormat.Format.nChannels = (WORD)format.channels;
+		waveFormat.Format.nSamplesPerSec = format.sampleRate;
+		waveFormat.Format.wBitsPerSample = 16;
+		waveFormat.Format.nBlockAlign = (WORD)(format.channels * 2);
+		waveFormat.Format.nAvgBytesPerSec = format.sampleRate * waveFormat.Format.nBlockAlign;
+
+		// Quad and 5.1 need the speaker positions spelled out, the mixer writes them in mask order
+		if (format.channels > 2)
+		{
+			waveFormat.Format.wFormatTag = WAVE_FORMAT_EXTENSIBLE;
+			waveFormat.Format.cbSize = sizeof(WAVEFORMATEXTENSIBLE) - sizeof(WAVEFORMATEX);
+			waveFormat.Samples.wValidBitsPerSample = 16;
+			waveFormat.dwChannelMask = (format.channels == 4) ? KSAUDIO_SPEAKER_QUAD : KSAUDIO_SPEAKER_5POINT1;
+			waveFormat.SubFormat = KSDATAFORMAT_SUBTYPE_PCM;
+		}
+
+		m_periodBytes = format.periodFrames * waveFormat.Format.nBlockAlign;
+		m_streamBytes = m_periodBytes * STREAM_PERIODS;
+
+		DSBUFFERDESC dsbd;
+		ZeroMemory(&dsbd, sizeof(DSBUFFERDESC));
+		dsbd.dwSize = sizeof(DSBUFFERDESC);
+		dsbd.dwFlags = DSBCAPS_GLOBALFOCUS | DSBCAPS_GETCURRENTPOSITION2;
+		dsbd.dwBufferBytes = m_streamBytes;
+		dsbd.lpwfxFormat = &waveFormat.Format;
+
+		hr = m_dsound->CreateSoundBuffer(&dsbd, &m_stream, NULL);
+		if (FAILED(hr))
+		{
+			info("DirectSoundBackend: CreateSoundBuffer failed: 0x%08x", hr);
+			close();
+			return false;
+		}
+
+		// Start from silence, the stream thread fills in periods ahead of the play cursor
+		void* ptr1 = nullptr;
+		void* ptr2 = nullptr;
+		DWORD bytes1 = 0, bytes2 = 0;
+		if (SUCCEEDED(m_stream->Lock(0, m_streamBytes, &ptr1, &bytes1, &ptr2, &bytes2, 0)))
+		{
+			memset(ptr1, 0, bytes1);
+			m_stream->Unlock(ptr1, bytes1, ptr2, bytes2);
+		}
+
+		hr = m_stream->Play(0, 0, DSBPLAY_LOOPING);
+		if (FAILED(hr))
+		{
+			info("DirectSoundBackend: Play failed: 0x%08x", hr);
+			close();
+			return false;
+		}
+
+		m_running = true;
+		m_thread = std::thread(&DirectSoundBackend::run, this);
+
+		info("DirectSoundBackend: Stream started, %d bytes", m_streamBytes);
+		return true;
+	}
+
+	unsigned int latency() const override
+	{
+		return m_format.periodFrames * (STREAM_PERIODS - 1);
+	}
+
+	void close() override
+	{
+		if (m_running)
+		{
+			m_running = false;
+			m_thread.join();
+		}
+
+		if (m_stream)
+		{
+			m_stream->Stop();
+			m_stream->Release();
+			m_stream = nullptr;
+		}
+
+		if (m_dsound)
+		{
+			m_dsound->Release();
+			m_dsound = nullptr;
+		}
+	}
+
+private:
+	void run()
+	{
+		std::vector<int16_t> period(m_format.periodFrames * m_format.channels);
+		const DWORD sleepMs = (m_format.periodFrames * 1000 / m_format.sampleRate) / 2;
+
+		DWORD writeOffset = m_periodBytes;
+
+		while (m_running)
+		{
+			DWORD status = 0;
+			m_stream->GetStatus(&status);
+			if (status & DSBSTATUS_BUFFERLOST)
+			{
+				if (FAILED(m_stream->Restore()))
+				{
+					Sleep(sleepMs);
+					continue;
+				}
+				m_stream->Play(0, 0, DSBPLAY_LOOPING);
+			}
+
+			DWORD playCursor = 0;
+			DWORD writeCursor = 0;
+			if (FAILED(m_stream->GetCurrentPosition(&playCursor, &writeCursor)))
+			{
+				Sleep(sleepMs);
+				continue;
+			}
+
+			DWORD freeBytes = (playCursor + m_streamBytes - writeOffset) % m_streamBytes;
+
+			while (freeBytes >= m_periodBytes)
+			{
+				m_callback(period.data(), m_format.periodFrames);
+
+				void* ptr1 = nullptr;
+				void* ptr2 = nullptr;
+				DWORD bytes1 = 0, bytes2 = 0;
+
+				if (SUCCEEDED(m_stream->Lock(writeOffset, m_periodBytes, &ptr1, &bytes1, &ptr2, &bytes2, 0)))
+				{
+					memcpy(ptr1, period.data(), bytes1);
+					if (ptr2 && bytes2 > 0)
+					{
+						memcpy(ptr2, (uint8_t*)period.data() + bytes1, bytes2);
+					}
+					m_stream->Unlock(ptr1, bytes1, ptr2, bytes2);
+				}
+
+				writeOffset = (writeOffset + m_periodBytes) % m_streamBytes;
+				freeBytes -= m_periodBytes;
+			}
+
+			Sleep(sleepMs);
+		}
+	}
+
+	OutputFormat m_format;
+	IDirectSound8* m_dsound;
+	IDirectSoundBuffer* m_stream;
+	DWORD m_periodBytes;
+	DWORD m_streamBytes;
+	OutputPeriodCallback m_callback;
+	std::thread m_thread;
+	std::atomic<bool> m_running;
+};
+
+OutputBackend* createDirectSoundBackend()
+{
+	return new DirectSoundBackend();
+}
@@ -0,0 +1,19 @@
+/*
+* This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+*
+* See LICENSE and MENTIONS in the root of the source tree for information
+* regarding licensing.
+*/
+#include "backend.h"
+
+// Renders every period in real time and throws it away.
+class NullBackend : public PacedBackend
+{
+public:
+	const char* name() const override { return "null"; }
+};
+
+OutputBackend* createNullBackend()
+{
+	return new NullBackend();
+}
@@ -0,0 +1,89 @@
+/*
+* This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+*
+* See LICENSE and MENTIONS in the root of the source tree for information
+* regarding licensing.
+*/
+#include "backend.h"
+
+#include <vector>
+#include <string.h>
+
+// No clock and no thread: periods are only mixed when the host renders. The mixer
+// always runs whole periods and the remainder is handed out on the next call, so
+// output does not depend on how the host splits its render calls.
+class OfflineBackend : public OutputBackend
+{
+public:
+	OfflineBackend()
+		: m_callback(nullptr), m_readFrame(0), m_availableFrames(0)
+	{
+	}
+
+	const char* name() const override { return "offline"; }
+
+	bool open(const OutputFormat& format, OutputPeriodCallback callback) override
+	{
+		m_format = format;
+		m_callback = callback;
+		m_period.assign(format.periodFrames * format.channels, 0);
+		m_readFrame = 0;
+		m_availableFrames = 0;
+		return true;
+	}
+
+	unsigned int latency() const override
+	{
+		return 0;
+	}
+
+	void close() override
+	{
+	}
+
+	bool pullDriven() const override
+	{
+		return true;
+	}
+
+	unsigned int render(int16_t* output, unsigned int frames) override
+	{
+		unsigned int written = 0;
+
+		while (written < frames)
+		{
+			if (m_availableFrames == 0)
+			{
+				m_callback(m_period.data(), m_format.periodFrames);
+				m_readFrame = 0;
+				m_availableFrames = m_format.periodFrames;
+			}
+
+			unsigned int count = frames - written;
+			if (count > m_availableFrames)
+				count = m_availableFrames;
+
+			memcpy(output + written * m_format.channels,
+				m_period.data() + m_readFrame * m_format.channels,
+				count * m_format.channels * sizeof(int16_t));
+
+			written += count;
+			m_readFrame += count;
+			m_availableFrames -= count;
+		}
+
+		return written;
+	}
+
+private:
+	OutputFormat m_format;
+	OutputPeriodCallback m_callback;
+	std::vector<int16_t> m_period;
+	unsigned int m_readFrame;
+	unsigned int m_availableFrames;
+};
+
+OutputBackend* createOfflineBackend()
+{
+	return new OfflineBackend();
+}
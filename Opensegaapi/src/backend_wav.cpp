@@ -0,0 +1,102 @@
+/*
+* This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+*
+* See LICENSE and MENTIONS in the root of the source tree for information
+* regarding licensing.
+*/
+#include "backend.h"
+#include "log.h"
+
+#include <stdio.h>
+#include <string>
+
+// Streams every period into a 16-bit PCM WAV file, paced in real time. The RIFF
+// and data chunk sizes are patched in when the backend is closed.
+class WavBackend : public PacedBackend
+{
+public:
+	explicit WavBackend(const char* path)
+		: m_path(path), m_file(nullptr), m_dataBytes(0)
+	{
+	}
+
+	const char* name() const override { return "wav"; }
+
+protected:
+	bool openSink() override
+	{
+		m_file = fopen(m_path.c_str(), "wb");
+		if (m_file == nullptr)
+		{
+			info("WavBackend: Failed to open file %s", m_path.c_str());
+			return false;
+		}
+
+		m_dataBytes = 0;
+		writeHeader();
+		return true;
+	}
+
+	void writePeriod(const int16_t* samples, unsigned int frames) override
+	{
+		size_t bytes = (size_t)frames * m_format.channels * sizeof(int16_t);
+		fwrite(samples, 1, bytes, m_file);
+		m_dataBytes += (uint32_t)bytes;
+	}
+
+	void closeSink() override
+	{
+		if (m_file == nullptr)
+			return;
+
+		fseek(m_file, 0, SEEK_SET);
+		writeHeader();
+		fclose(m_file);
+		m_file = nullptr;
+
+		info("WavBackend: Wrote %d bytes to %s", m_dataBytes, m_path.c_str());
+	}
+
+private:
+	void write16(uint16_t value)
+	{
+		uint8_t bytes[2] = { (uint8_t)value, (uint8_t)(value >> 8) };
+		fwrite(bytes, 1, 2, m_file);
+	}
+
+	void write32(uint32_t value)
+	{
+		uint8_t bytes[4] = { (uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24) };
+		fwrite(bytes, 1, 4, m_file);
+	}
+
+	void writeHeader()
+	{
+		uint16_t blockAlign = (uint16_t)(m_format.channels * sizeof(int16_t));
+
+		fwrite("RIFF", 1, 4, m_file);
+		write32(36 + m_dataBytes);
+		fwrite("WAVE", 1, 4, m_file);
+
+		fwrite("fmt ", 1, 4, m_file);
+		write32(16);
+		write16(1); // PCM
+		write16((uint16_t)m_format.channels);
+		write32(m_format.sampleRate);
+		write32(m_format.sampleRate * blockAlign);
+		write16(blockAlign);
+		write16(16);
+
+		fwrite("data", 1, 4, m_file);
+		write32(m_dataBytes);
+	}
+
+	std::string m_path;
+	FILE* m_file;
+	uint32_t m_dataBytes;
+};
+
+OutputBackend* createWavBackend(const char* path)
+{
+	return new WavBackend(path);
+}
@@ -0,0 +1,56 @@
+/*
+* This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+*
+* See LICENSE and MENTIONS in the root of the source tree for information
+* regarding licensing.
+*/
+#pragma once
+
+extern "C" {
+#include "opensegaapi.h"
+}
+
+#include "mixer.h"
+
+#include <stdint.h>
+
+struct OPEN_segaapiBuffer_t
+{
+	void* userData;
+	OPEN_HAWOSEGABUFFERCALLBACK callback;
+	bool synthesizer;
+	bool loop;
+	unsigned int channels;
+	unsigned int startLoop;
+	unsigned int endLoop;
+	unsigned int endOffset;
+	unsigned int sampleRate;
+	unsigned int sampleFormat;
+	uint8_t* data;
+	size_t size;
+	bool playing;
+	bool paused;
+	bool playWithSetup;
+	bool ownsData;
+
+	WAVEFORMATEX format;
+
+	float sendVolumes[7];
+	int sendChannels[7];
+	OPEN_HAROUTING sendRoutes[7];
+	float channelVolumes[6];
+
+	float masterVolume;
+	float frequency;
+	unsigned int priority;
+
+	unsigned int notifyPoints[MIXER_MAX_NOTIFY_POINTS]; // frames, in the order they were set
+	unsigned int notifyPointCount;
+	unsigned int notifyFrequency; // frames, 0 for none
+
+	unsigned int playSerial; // counts plays, the mixer echoes it back when the run ends
+
+	// The fields above are what the game set and what the getters report. The mixer
+	// plays from its own copy, kept in step through mixer commands.
+	MixerVoice voice;
+};
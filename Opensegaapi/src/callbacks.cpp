@@ -0,0 +1,111 @@
+/*
+* This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+*
+* See LICENSE and MENTIONS in the root of the source tree for information
+* regarding licensing.
+*/
+#include "callbacks.h"
+#include "command_ring.h"
+#include "log.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+static CommandRing<CallbackEvent, CALLBACK_QUEUE_CAPACITY> g_events;
+
+static std::thread g_thread;
+static std::mutex g_wakeMutex; // never held while a callback runs
+static std::condition_variable g_wakeCondition;
+static bool g_wake;
+static bool g_running;
+static bool g_threaded;
+
+// Consumer side of g_events: the thread when there is one, otherwise callbackDeliver,
+// whose callers do not overlap
+static void deliverEvents()
+{
+	g_events.drain([](const CallbackEvent& event)
+	{
+		event.callback(event.handle, event.message);
+	});
+}
+
+static void run()
+{
+	std::unique_lock<std::mutex> lock(g_wakeMutex);
+
+	for (;;)
+	{
+		g_wakeCondition.wait(lock, [] { return g_wake || !g_running; });
+
+		bool running = g_running;
+		g_wake = false;
+
+		lock.unlock();
+		deliverEvents();
+		lock.lock();
+
+		if (!running)
+			break;
+	}
+}
+
+void callbackStart(bool threaded)
+{
+	// Already dispatching, a second thread would be assigned over the running one
+	if (g_thread.joinable())
+		return;
+
+	g_threaded = threaded;
+
+	if (!threaded)
+		return;
+
+	g_wake = false;
+	g_running = true;
+	g_thread = std::thread(run);
+}
+
+void callbackStop()
+{
+	if (!g_threaded)
+	{
+		deliverEvents();
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(g_wakeMutex);
+		g_running = false;
+	}
+
+	g_wakeCondition.notify_one();
+	g_thread.join();
+	g_threaded = false;
+}
+
+bool callbackPost(const CallbackEvent& event)
+{
+	if (g_events.push(&event, 1))
+		return true;
+
+	info("callbackPost: Queue full, dropping callback for %08X", event.handle);
+	return false;
+}
+
+void callbackDeliver()
+{
+	if (!g_threaded)
+	{
+		deliverEvents();
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(g_wakeMutex);
+		g_wake = true;
+	}
+
+	g_wakeCondition.notify_one();
+}
@@ -0,0 +1,37 @@
+/*
+* This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+*
+* See LICENSE and MENTIONS in the root of the source tree for information
+* regarding licensing.
+*/
+#pragma once
+
+extern "C" {
+#include "opensegaapi.h"
+}
+
+// Callbacks waiting to be delivered, any further ones are dropped
+#define CALLBACK_QUEUE_CAPACITY 1024
+
+// One call of a buffer callback. The handle is copied rather than the buffer looked up
+// at delivery, so a buffer destroyed in between only leaves the game a stale handle.
+struct CallbackEvent
+{
+	void* handle;
+	OPEN_HAWOSEGABUFFERCALLBACK callback;
+	OPEN_HAWOSMESSAGETYPE message;
+};
+
+// Threaded: callbacks run on a thread of their own, so game code never holds up the
+// mixer. Otherwise they run on whichever thread calls callbackDeliver, for hosts that
+// render themselves and expect a period's callbacks to be done when it returns.
+void callbackStart(bool threaded);
+
+// Delivers whatever is still queued, then stops the thread.
+void callbackStop();
+
+// Queues a call from any thread. Never waits, returns false when the queue is full.
+bool callbackPost(const CallbackEvent& event);
+
+// Wakes the thread for the calls posted so far, or when not threaded makes them here.
+void callbackDeliver();
@@ -0,0 +1,112 @@
+/*
+* This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+*
+* See LICENSE and MENTIONS in the root of the source tree for information
+* regarding licensing.
+*/
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+// Bounded queue of plain structs with any number of producers and one consumer.
+// Every slot carries a sequence number telling whose turn it is, so producers only
+// contend on the tail and never allocate, and the consumer never waits on them.
+template<typename T, unsigned int Capacity>
+class CommandRing
+{
+	static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+	CommandRing()
+		: m_tail(0), m_head(0)
+	{
+		for (unsigned int i = 0; i < Capacity; i++)
+		{
+			m_slots[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	// Queues all items or, when there is not room for all of them, none. The consumer
+	// sees the items of one push together, never just the first few.
+	bool push(const T* items, unsigned int count)
+	{
+		if (count == 0)
+			return true;
+		if (count > Capacity)
+			return false;
+
+		uint32_t pos = m_tail.load(std::memory_order_relaxed);
+
+		for (;;)
+		{
+			// Slots are consumed in order, so once the last one is free all of them are
+			uint32_t last = pos + count - 1;
+			uint32_t sequence = m_slots[last & (Capacity - 1)].sequence.load(std::memory_order_acquire);
+			int32_t diff = (int32_t)(sequence - last);
+
+			if (diff == 0)
+			{
+				if (m_tail.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0)
+			{
+				return false;
+			}
+			else
+			{
+				pos = m_tail.load(std::memory_order_relaxed);
+			}
+		}
+
+		for (unsigned int i = 0; i < count; i++)
+		{
+			m_slots[(pos + i) & (Capacity - 1)].item = items[i];
+		}
+
+		// Publish back to front: the consumer stops at the first slot that is not
+		// ready, which is the first of the batch until the whole batch is
+		for (unsigned int i = count; i-- > 0;)
+		{
+			m_slots[(pos + i) & (Capacity - 1)].sequence.store(pos + i + 1, std::memory_order_release);
+		}
+
+		return true;
+	}
+
+	// Consumer only. Hands every published item to handler in push order and returns
+	// how many there were. Items pushed while draining may or may not be included.
+	template<typename Handler>
+	unsigned int drain(Handler&& handler)
+	{
+		unsigned int count = 0;
+
+		for (;;)
+		{
+			Slot& slot = m_slots[m_head & (Capacity - 1)];
+
+			if (slot.sequence.load(std::memory_order_acquire) != m_head + 1)
+				break;
+
+			handler(slot.item);
+
+			slot.sequence.store(m_head + Capacity, std::memory_order_release);
+			m_head++;
+			count++;
+		}
+
+		return count;
+	}
+
+private:
+	struct Slot
+	{
+		std::atomic<uint32_t> sequence;
+		T item;
+	};
+
+	Slot m_slots[Capacity];
+	alignas(64) std::atomic<uint32_t> m_tail;
+	alignas(64) uint32_t m_head;
+};
@@ -0,0 +1,184 @@
+/*
+* This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+*
+* See LICENSE and MENTIONS in the root of the source tree for information
+* regarding licensing.
+*/
+#include "envelope.h"
+
+#include <math.h>
+
+static unsigned int secondsToFrames(float seconds, unsigned int sampleRate)
+{
+	return seconds > 0.0f ? (unsigned int)(seconds * sampleRate) : 0;
+}
+
+static void setExponential(Envelope* envelope, unsigned int frames)
+{
+	envelope->slope = expf(ENVELOPE_DECAY_LOG / frames);
+	envelope->blockFactor = powf(envelope->slope, (float)ENVELOPE_BLOCK_FRAMES);
+	envelope->exponential = true;
+}
+
+// Enters the segment after from. Segments of zero length are skipped on to the next,
+// the same sequence as tsf_voice_envelope_nextsegment.
+static void nextSegment(Envelope* envelope, int from, unsigned int sampleRate)
+{
+	const EnvelopeParameters& parameters = envelope->parameters;
+	unsigned int frames;
+
+	envelope->exponential = false;
+
+	switch (from + 1)
+	{
+	case ENVELOPE_DELAY:
+		frames = secondsToFrames(parameters.delay, sampleRate);
+		if (frames > 0)
+		{
+			envelope->segment = ENVELOPE_DELAY;
+			envelope->framesLeft = frames;
+			envelope->level = 0.0f;
+			envelope->slope = 0.0f;
+			return;
+		}
+		// fall through
+	case ENVELOPE_ATTACK:
+		frames = secondsToFrames(parameters.attack, sampleRate);
+		if (frames > 0)
+		{
+			envelope->segment = ENVELOPE_ATTACK;
+			envelope->framesLeft = frames;
+			envelope->level = 0.0f;
+			envelope->slope = 1.0f / frames;
+			return;
+		}
+		// fall through
+	case ENVELOPE_HOLD:
+		frames = secondsToFrames(parameters.hold, sampleRate);
+		if (frames > 0)
+		{
+			envelope->segment = ENVELOPE_HOLD;
+			envelope->framesLeft = frames;
+			envelope->level = 1.0f;
+			envelope->slope = 0.0f;
+			return;
+		}
+		// fall through
+	case ENVELOPE_DECAY:
+		frames = secondsToFrames(parameters.decay, sampleRate);
+		if (frames > 0)
+		{
+			envelope->segment = ENVELOPE_DECAY;
+			envelope->level = 1.0f;
+
+			if (envelope->volume)
+			{
+				// The decay time is how long falling to -80dB would take, the segment ends
+				// early where that curve meets the sustain level
+				setExponential(envelope, frames);
+				if (parameters.sustain > 0.0f)
+					frames = (unsigned int)(logf(parameters.sustain) / (ENVELOPE_DECAY_LOG / frames));
+			}
+			else
+			{
+				envelope->slope = -1.0f / frames;
+				frames = (unsigned int)(frames * (1.0f - parameters.sustain));
+			}
+
+			if (frames > 0)
+			{
+				envelope->framesLeft = frames;
+				return;
+			}
+		}
+		// fall through
+	case ENVELOPE_SUSTAIN:
+		envelope->segment = ENVELOPE_SUSTAIN;
+		envelope->level = parameters.sustain;
+		envelope->slope = 0.0f;
+		envelope->exponential = false;
+		return;
+	case ENVELOPE_RELEASE:
+		frames = secondsToFrames(parameters.release > 0.0f ? parameters.release : ENVELOPE_FAST_RELEASE, sampleRate);
+		if (frames == 0)
+			frames = 1;
+
+		envelope->segment = ENVELOPE_RELEASE;
+		envelope->framesLeft = frames;
+
+		if (envelope->volume)
+			setExponential(envelope, frames);
+		else
+			envelope->slope = -envelope->level / frames;
+		return;
+	default:
+		envelope->segment = ENVELOPE_DONE;
+		envelope->level = 0.0f;
+		envelope->slope = 0.0f;
+		return;
+	}
+}
+
+void envelopeInit(Envelope* envelope, bool volume)
+{
+	envelope->parameters.delay = 0.0f;
+	envelope->parameters.attack = 0.0f;
+	envelope->parameters.hold = 0.0f;
+	envelope->parameters.decay = 0.0f;
+	envelope->parameters.sustain = 1.0f;
+	envelope->parameters.release = 0.0f;
+	envelope->volume = volume;
+	envelope->segment = ENVELOPE_DONE;
+	envelope->level = 0.0f;
+	envelope->slope = 0.0f;
+	envelope->blockFactor = 1.0f;
+	envelope->exponential = false;
+	envelope->framesLeft = 0;
+}
+
+void envelopeSetParameter(Envelope* envelope, unsigned int index, float value)
+{
+	EnvelopeParameters& parameters = envelope->parameters;
+
+	switch (index)
+	{
+	case 0: parameters.delay = value; break;
+	case 1: parameters.attack = value; break;
+	case 2: parameters.hold = value; break;
+	case 3: parameters.decay = value; break;
+	case 4: parameters.sustain = value; break;
+	case 5: parameters.release = value; break;
+	}
+}
+
+void envelopeStart(Envelope* envelope, unsigned int sampleRate)
+{
+	nextSegment(envelope, ENVELOPE_DELAY - 1, sampleRate);
+}
+
+void envelopeRelease(Envelope* envelope, unsigned int sampleRate)
+{
+	if (envelope->segment < ENVELOPE_RELEASE)
+		nextSegment(envelope, ENVELOPE_SUSTAIN, sampleRate);
+}
+
+void envelopeAdvance(Envelope* envelope, unsigned int frames, unsigned int sampleRate)
+{
+	while (frames != 0 && envelope->segment != ENVELOPE_SUSTAIN && envelope->segment != ENVELOPE_DONE)
+	{
+		unsigned int count = frames < envelope->framesLeft ? frames : envelope->framesLeft;
+
+		if (!envelope->exponential)
+			envelope->level += envelope->slope * count;
+		else if (count == ENVELOPE_BLOCK_FRAMES)
+			envelope->level *= envelope->blockFactor;
+		else
+			envelope->level *= powf(envelope->slope, (float)count);
+
+		envelope->framesLeft -= count;
+		frames -= count;
+
+		if (envelope->framesLeft == 0)
+			nextSegment(envelope, envelope->segment, sampleRate);
+	}
+}
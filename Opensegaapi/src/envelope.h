@@ -0,0 +1,70 @@
+/*
+* This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+*
+* See LICENSE and MENTIONS in the root of the source tree for information
+* regarding licensing.
+*/
+#pragma once
+
+// Frames the mixer steps envelopes by at a time. Gains in between are ramped linearly
+// from the level at the start of the block to the level at its end.
+#define ENVELOPE_BLOCK_FRAMES 64
+
+// Level the volume envelope's exponential segments fall by over their length, -80dB
+#define ENVELOPE_DECAY_LOG -9.226f
+
+// Release used when none is set, short enough to sound like a stop but without the click
+#define ENVELOPE_FAST_RELEASE 0.01f
+
+enum EnvelopeSegment
+{
+	ENVELOPE_DELAY,
+	ENVELOPE_ATTACK,
+	ENVELOPE_HOLD,
+	ENVELOPE_DECAY,
+	ENVELOPE_SUSTAIN,
+	ENVELOPE_RELEASE,
+	ENVELOPE_DONE,
+};
+
+// Times in seconds, sustain as a level from 0 to 1
+struct EnvelopeParameters
+{
+	float delay;
+	float attack;
+	float hold;
+	float decay;
+	float sustain;
+	float release;
+};
+
+// DAHDSR envelope of a synth voice, stepped like TinySoundFont's (tsf.h): the attack
+// is linear, decay and release are exponential on the volume envelope and linear on
+// the modulation one.
+struct Envelope
+{
+	EnvelopeParameters parameters;
+	bool volume;              // volume envelope, decays and releases exponentially
+	int segment;
+	float level;
+	float slope;              // added every frame, multiplied in when exponential
+	float blockFactor;        // slope over ENVELOPE_BLOCK_FRAMES frames when exponential
+	bool exponential;
+	unsigned int framesLeft;  // until the next segment, unused while sustaining
+};
+
+// SF2 style defaults: every segment instantaneous, sustain at full level
+void envelopeInit(Envelope* envelope, bool volume);
+
+// Index counts from delay to release, the order of the OPEN_HAVP_*_VOL_ENV and
+// OPEN_HAVP_*_MOD_ENV parameters. Takes effect from the next segment entered.
+void envelopeSetParameter(Envelope* envelope, unsigned int index, float value);
+
+// Starts from the delay segment, skipping any that are zero length
+void envelopeStart(Envelope* envelope, unsigned int sampleRate);
+
+// Goes to the release segment from whatever level the envelope is at
+void envelopeRelease(Envelope* envelope, unsigned int sampleRate);
+
+// Moves frames on, through as many segments as they span
+void envelopeAdvance(Envelope* envelope, unsigned int frames, unsigned int sampleRate);
@@ -0,0 +1,148 @@
+/*
+* This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+*
+* See LICENSE and MENTIONS in the root of the source tree for information
+* regarding licensing.
+*/
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <deque>
+
+// Maps opaque handles to objects. A handle is a slot index plus the generation the
+// slot had when it was handed out; freeing a slot bumps its generation, so a stale
+// handle stops resolving instead of pointing at whatever took its place. Freed slots
+// are reused oldest first, and a slot whose generation would wrap is never reused, so
+// no handle ever comes back to life.
+//
+// add and remove must be serialized by the caller. lookup can run on any thread at
+// any time: slots live in chunks that are never moved or freed while the table exists.
+template<typename T>
+class HandleTable
+{
+public:
+	// Slot indices are stored plus one in the low 16 bits, so no handle is ever null
+	static const uint32_t MaxSlots = 0xFFFF;
+	// and generations in the high 16
+	static const uint32_t MaxGeneration = 0xFFFF;
+
+	HandleTable()
+		: m_slotCount(0)
+	{
+		for (uint32_t i = 0; i < ChunkCount; i++)
+		{
+			m_chunks[i].store(nullptr, std::memory_order_relaxed);
+		}
+	}
+
+	~HandleTable()
+	{
+		for (uint32_t i = 0; i < ChunkCount; i++)
+		{
+			delete[] m_chunks[i].load(std::memory_order_relaxed);
+		}
+	}
+
+	// Returns nullptr when every slot is taken
+	void* add(T* item)
+	{
+		uint32_t index;
+
+		if (!m_freeSlots.empty())
+		{
+			index = m_freeSlots.front();
+			m_freeSlots.pop_front();
+		}
+		else
+		{
+			index = m_slotCount.load(std::memory_order_relaxed);
+			if (index >= MaxSlots)
+				return nullptr;
+
+			if ((index % ChunkSize) == 0)
+				m_chunks[index / ChunkSize].store(new Slot[ChunkSize], std::memory_order_release);
+
+			m_slotCount.store(index + 1, std::memory_order_release);
+		}
+
+		Slot& slot = slotAt(index);
+		slot.item.store(item, std::memory_order_release);
+
+		return (void*)(uintptr_t)((slot.generation.load(std::memory_order_relaxed) << 16) | (index + 1));
+	}
+
+	// Returns the object the handle referred to, or nullptr if it was already stale
+	T* remove(void* handle)
+	{
+		uint32_t index;
+		T* item = resolve(handle, index);
+		if (item == nullptr)
+			return nullptr;
+
+		Slot& slot = slotAt(index);
+		uint32_t generation = slot.generation.load(std::memory_order_relaxed) + 1;
+		slot.generation.store(generation, std::memory_order_release);
+		slot.item.store(nullptr, std::memory_order_release);
+
+		// Past MaxGeneration no handle can name the slot, so it is retired
+		if (generation <= MaxGeneration)
+			m_freeSlots.push_back(index);
+		return item;
+	}
+
+	T* lookup(void* handle) const
+	{
+		uint32_t index;
+		return resolve(handle, index);
+	}
+
+private:
+	static const uint32_t ChunkSize = 256;
+	static const uint32_t ChunkCount = (MaxSlots + ChunkSize - 1) / ChunkSize;
+
+	struct Slot
+	{
+		Slot() : generation(0), item(nullptr) {}
+
+		std::atomic<uint32_t> generation;
+		std::atomic<T*> item;
+	};
+
+	Slot& slotAt(uint32_t index) const
+	{
+		return m_chunks[index / ChunkSize].load(std::memory_order_acquire)[index % ChunkSize];
+	}
+
+	T* resolve(void* handle, uint32_t& index) const
+	{
+		uint32_t value = (uint32_t)(uintptr_t)handle;
+
+		if ((uintptr_t)handle != value || (value & 0xFFFF) == 0)
+			return nullptr;
+
+		index = (value & 0xFFFF) - 1;
+		uint32_t generation = value >> 16;
+
+		if (index >= m_slotCount.load(std::memory_order_acquire))
+			return nullptr;
+
+		Slot& slot = slotAt(index);
+
+		// Generation is checked on both sides of reading the object, so a slot that is
+		// freed and reused in between is not mistaken for the one the handle named
+		if (slot.generation.load(std::memory_order_acquire) != generation)
+			return nullptr;
+
+		T* item = slot.item.load(std::memory_order_acquire);
+
+		if (slot.generation.load(std::memory_order_acquire) != generation)
+			return nullptr;
+
+		return item;
+	}
+
+	std::atomic<Slot*> m_chunks[ChunkCount];
+	std::atomic<uint32_t> m_slotCount;
+	std::deque<uint32_t> m_freeSlots;
+};
@@ -0,0 +1,43 @@
+/*
+* This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+*
+* See LICENSE and MENTIONS in the root of the source tree for information
+* regarding licensing.
+*/
+#include "lfo.h"
+
+void lfoInit(Lfo* lfo)
+{
+	lfo->delay = 0.0f;
+	lfo->frequency = 8.176f;
+	lfo->framesLeft = 0;
+	lfo->level = 0.0f;
+	lfo->delta = 0.0f;
+}
+
+void lfoStart(Lfo* lfo, unsigned int sampleRate)
+{
+	lfo->framesLeft = lfo->delay > 0.0f ? (unsigned int)(lfo->delay * sampleRate) : 0;
+	lfo->level = 0.0f;
+	lfo->delta = 4.0f * lfo->frequency / sampleRate;
+}
+
+void lfoAdvance(Lfo* lfo, unsigned int frames)
+{
+	if (lfo->framesLeft >= frames)
+	{
+		lfo->framesLeft -= frames;
+		return;
+	}
+
+	frames -= lfo->framesLeft;
+	lfo->framesLeft = 0;
+	lfo->level += lfo->delta * frames;
+
+	// Folds back at the peaks, more than once when a block spans several
+	while (lfo->level > 1.0f || lfo->level < -1.0f)
+	{
+		lfo->level = (lfo->level > 0.0f ? 2.0f : -2.0f) - lfo->level;
+		lfo->delta = -lfo->delta;
+	}
+}
@@ -0,0 +1,25 @@
+/*
+* This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+*
+* See LICENSE and MENTIONS in the root of the source tree for information
+* regarding licensing.
+*/
+#pragma once
+
+// Triangle LFO of a synth voice, swinging between -1 and 1 and starting from 0 on the
+// way up once its delay is over. Stepped once per mixer block like the envelopes, the
+// same way as TinySoundFont's tsf_voice_lfo.
+struct Lfo
+{
+	float delay;              // seconds
+	float frequency;          // Hz
+	unsigned int framesLeft;  // of the delay
+	float level;
+	float delta;              // level change per frame, negative on the way down
+};
+
+// SF2 defaults: no delay, 8.176 Hz
+void lfoInit(Lfo* lfo);
+
+void lfoStart(Lfo* lfo, unsigned int sampleRate);
+void lfoAdvance(Lfo* lfo, unsigned int frames);
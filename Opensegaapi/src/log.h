@@ -0,0 +1,13 @@
+/*
+* This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+*
+* See LICENSE and MENTIONS in the root of the source tree for information
+* regarding licensing.
+*/
+#pragma once
+
+#ifdef _DEBUG
+void info(const char* format, ...);
+#else
+#define info(x, ...) {}
+#endif
@@ -0,0 +1,1443 @@
+/*
+* This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+*
+* See LICENSE and MENTIONS in the root of the source tree for information
+* regarding licensing.
+*/
+#include "mixer.h"
+#include "mixer_kernels.h"
+#include "command_ring.h"
+#include "callbacks.h"
+#include "resampler.h"
+#include "reverb.h"
+#include "log.h"
+
+extern "C" {
+#include "opensegaapi.h"
+}
+
+#include <vector>
+#include <thread>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static CommandRing<MixerCommand, MIXER_COMMAND_CAPACITY> g_commands;
+// Held while mixer state is touched: by the render for a whole period, by a producer
+// that finds the queue full and drains it itself
+static std::atomic_flag g_mixerBusy = ATOMIC_FLAG_INIT;
+
+static std::vector<MixerVoice*> g_activeVoices;
+static unsigned int g_mixerSampleRate = MIXER_SAMPLE_RATE;
+static unsigned int g_mixerChannels = 2;
+static unsigned int g_maxVoices = MIXER_DEFAULT_MAX_VOICES;
+static float g_audibleLevel;
+static float g_foldDown[MIXER_PORTS][MIXER_MAX_CHANNELS];
+static float g_ioVolumes[MIXER_PORTS] = { 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f };
+// Bumped when something every voice's gains depend on changes
+static unsigned int g_routingGeneration;
+static const MixerKernels* g_kernels;
+static ResamplerQuality g_resampler = RESAMPLER_LINEAR;
+// Callbacks posted this period, delivered once it is done
+static unsigned int g_eventCount;
+alignas(32) static float g_mixBus[MIXER_MAX_CHANNELS][MIXER_MAX_PERIOD_FRAMES];
+// What voices send to each FX slot. Only cleared, and the slot only run, in periods
+// something is sent to it or its reverb is still ringing.
+alignas(32) static float g_fxBus[MIXER_FX_SLOTS][MIXER_MAX_PERIOD_FRAMES];
+static bool g_fxFed[MIXER_FX_SLOTS];
+static bool g_fxLoaded[MIXER_FX_SLOTS];
+static Reverb g_fxReverbs[MIXER_FX_SLOTS];
+// Left port of the pair the FX slots return to, the right one is the next
+static int g_fxReturnPort = OPEN_HA_FRONT_LEFT_PORT;
+static unsigned int g_renderFrames;
+// Resampled source channels of the voice being mixed
+alignas(32) static float g_voiceScratch[MIXER_MAX_SOURCE_CHANNELS][MIXER_MAX_PERIOD_FRAMES];
+// One channel of the source frames under a block of filtered output, and where in it
+// each output frame reads. The linear path only uses the positions, as samples into the data.
+alignas(32) static float g_sourceRun[MIXER_RUN_FRAMES];
+static unsigned int g_runOffsets[MIXER_FILTER_BLOCK];
+static unsigned int g_runNext[MIXER_FILTER_BLOCK];
+static float g_runFractions[MIXER_FILTER_BLOCK];
+static const float* g_runPhases[MIXER_FILTER_BLOCK];
+// Channels of filtered voices waiting to be low-passed together, a lane each. Frames are
+// interleaved across the lanes, so one vector holds the same frame of all of them.
+alignas(32) static float g_filterLanes[MIXER_MAX_PERIOD_FRAMES * MIXER_FILTER_LANES];
+// Coefficients of each block of the period as the lowpass kernel takes them
+alignas(32) static float g_filterBlocks[MIXER_MAX_PERIOD_FRAMES / ENVELOPE_BLOCK_FRAMES][6 * MIXER_FILTER_LANES];
+static MixerVoice* g_laneVoices[MIXER_FILTER_LANES];
+static unsigned int g_laneChannels[MIXER_FILTER_LANES];
+static unsigned int g_laneCount;
+static unsigned int g_laneFrames;
+
+// Output channel gains for each port. Without a center or LFE speaker the center goes
+// to both fronts at -3dB and the LFE at -20dB, the level the DirectSound path used.
+static const float g_stereoFoldDown[MIXER_PORTS][2] =
+{
+	{ 1.0f, 0.0f },
+	{ 0.0f, 1.0f },
+	{ 0.7071f, 0.7071f },
+	{ 0.1f, 0.1f },
+	{ 1.0f, 0.0f },
+	{ 0.0f, 1.0f },
+};
+
+static const float g_quadFoldDown[MIXER_PORTS][4] =
+{
+	{ 1.0f, 0.0f, 0.0f, 0.0f },
+	{ 0.0f, 1.0f, 0.0f, 0.0f },
+	{ 0.7071f, 0.7071f, 0.0f, 0.0f },
+	{ 0.1f, 0.1f, 0.0f, 0.0f },
+	{ 0.0f, 0.0f, 1.0f, 0.0f },
+	{ 0.0f, 0.0f, 0.0f, 1.0f },
+};
+
+void mixerInit(unsigned int sampleRate, unsigned int channels)
+{
+	if (channels != 4 && channels != 6)
+		channels = 2;
+
+	g_mixerSampleRate = sampleRate;
+	g_mixerChannels = channels;
+	g_activeVoices.reserve(256);
+	g_kernels = mixerSelectKernels();
+	g_resampler = resamplerInit();
+
+	const char* maxVoices = getenv("OPENSEGAAPI_MAXVOICES");
+	g_maxVoices = maxVoices != nullptr ? (unsigned int)strtoul(maxVoices, nullptr, 10) : MIXER_DEFAULT_MAX_VOICES;
+
+	const char* audible = getenv("OPENSEGAAPI_AUDIBLEDB");
+	g_audibleLevel = (float)pow(10.0, (audible != nullptr ? strtod(audible, nullptr) : MIXER_DEFAULT_AUDIBLE_DB) / 20.0);
+
+	for (int port = 0; port < MIXER_PORTS; port++)
+	{
+		for (unsigned int out = 0; out < MIXER_MAX_CHANNELS; out++)
+		{
+			if (channels == 2)
+				g_foldDown[port][out] = out < 2 ? g_stereoFoldDown[port][out] : 0.0f;
+			else if (channels == 4)
+				g_foldDown[port][out] = out < 4 ? g_quadFoldDown[port][out] : 0.0f;
+			else
+				g_foldDown[port][out] = (int)out == port ? 1.0f : 0.0f;
+		}
+	}
+
+	for (int slot = 0; slot < MIXER_FX_SLOTS; slot++)
+	{
+		reverbInit(&g_fxReverbs[slot], sampleRate);
+		g_fxLoaded[slot] = true;
+	}
+
+	info("mixerInit: sampleRate=%d channels=%d period=%d kernels=%s resampler=%s maxVoices=%d audibleLevel=%f", sampleRate, channels, MIXER_PERIOD_FRAMES, g_kernels->name, resamplerName(g_resampler), g_maxVoices, g_audibleLevel);
+}
+
+static void startVoice(MixerVoice* voice)
+{
+	if (voice->activeIndex >= 0)
+		return;
+
+	voice->activeIndex = (int)g_activeVoices.size();
+	g_activeVoices.push_back(voice);
+}
+
+static void stopVoice(MixerVoice* voice)
+{
+	if (voice->activeIndex < 0)
+		return;
+
+	// Swap-remove so the list stays dense
+	MixerVoice* last = g_activeVoices.back();
+	g_activeVoices[voice->activeIndex] = last;
+	last->activeIndex = voice->activeIndex;
+	g_activeVoices.pop_back();
+
+	voice->activeIndex = -1;
+}
+
+unsigned int mixerChannels()
+{
+	return g_mixerChannels;
+}
+
+// Rebuilds a voice's gains, and the level they add up to, from its sends. Every send adds its level to one source
+// channel x port cell, which is then folded down to the device layout.
+static void updateRouting(MixerVoice* voice)
+{
+	float levels[MIXER_MAX_SOURCE_CHANNELS][MIXER_PORTS] = { { 0.0f } };
+	float fxLevels[MIXER_MAX_SOURCE_CHANNELS][MIXER_FX_SLOTS] = { { 0.0f } };
+	int numValidRoutes = 0;
+
+	for (int i = 0; i < 7; i++)
+	{
+		int destPort = voice->sendRoutes[i];
+		int slot = destPort - OPEN_HA_FXSLOT0_PORT;
+		bool fx = slot >= 0 && slot < MIXER_FX_SLOTS;
+
+		if (destPort == (int)OPEN_HA_UNUSED_PORT ||
+			destPort < 0 ||
+			(destPort >= MIXER_PORTS && !fx) ||
+			(fx && !g_fxLoaded[slot]) ||
+			voice->sendVolumes[i] <= 0.0f)
+		{
+			continue;
+		}
+
+		int srcChannel = voice->sendChannels[i];
+
+		if (srcChannel < 0 || srcChannel >= (int)voice->channels || srcChannel >= MIXER_MAX_SOURCE_CHANNELS)
+		{
+			info("updateRouting: WARNING - Send %d has invalid srcChannel %d (buffer has %d channels)",
+				i, srcChannel, voice->channels);
+			continue;
+		}
+
+		// Output ports map one to one onto the physical outputs of the same number, FX
+		// slots go through the volume of the ports they return to instead
+		float level = voice->sendVolumes[i] * voice->channelVolumes[srcChannel] * voice->masterVolume;
+
+		if (fx)
+			fxLevels[srcChannel][slot] += level;
+		else
+			levels[srcChannel][destPort] += level * g_ioVolumes[destPort];
+
+		numValidRoutes++;
+
+		info("updateRouting: Send %d - SrcChan %d -> DestPort %d, Level %f", i, srcChannel, destPort, level);
+	}
+
+	for (unsigned int ch = 0; ch < MIXER_MAX_SOURCE_CHANNELS; ch++)
+	{
+		for (unsigned int out = 0; out < g_mixerChannels; out++)
+		{
+			float gain = 0.0f;
+
+			for (int port = 0; port < MIXER_PORTS; port++)
+			{
+				gain += levels[ch][port] * g_foldDown[port][out];
+			}
+
+			voice->gains[ch * g_mixerChannels + out] = gain;
+		}
+	}
+
+	voice->level = 0.0f;
+	for (unsigned int i = 0; i < voice->channels * g_mixerChannels; i++)
+	{
+		if (voice->gains[i] > voice->level)
+			voice->level = voice->gains[i];
+	}
+
+	// Only the slots sent to get a bus in the voice's mix, so slots nothing sends to
+	// cost nothing
+	voice->fxSlotCount = 0;
+	for (unsigned int slot = 0; slot < MIXER_FX_SLOTS; slot++)
+	{
+		for (unsigned int ch = 0; ch < voice->channels; ch++)
+		{
+			if (fxLevels[ch][slot] > 0.0f)
+			{
+				voice->fxSlots[voice->fxSlotCount++] = slot;
+				break;
+			}
+		}
+	}
+
+	for (unsigned int ch = 0; ch < voice->channels; ch++)
+	{
+		for (unsigned int i = 0; i < voice->fxSlotCount; i++)
+		{
+			float gain = fxLevels[ch][voice->fxSlots[i]];
+
+			voice->fxGains[ch * voice->fxSlotCount + i] = gain;
+			if (gain > voice->level)
+				voice->level = gain;
+		}
+	}
+
+	voice->pendingRouting = false;
+	voice->routingGeneration = g_routingGeneration;
+
+	info("updateRouting: Voice %08X - master=%f, routes=%d, channels=%d", voice, voice->masterVolume, numValidRoutes, voice->channels);
+}
+
+// Cursors are 32.32 fixed point, whole frames in the high half and the fraction in the
+// low one. Stepping one is a 64-bit add, exact however long a voice plays.
+static inline uint64_t frameCursor(unsigned int frame)
+{
+	return (uint64_t)frame << 32;
+}
+
+static inline unsigned int cursorFrame(uint64_t cursor)
+{
+	return (unsigned int)(cursor >> 32);
+}
+
+static inline double cursorFrames(uint64_t cursor)
+{
+	return cursor * (1.0 / 4294967296.0);
+}
+
+// The top 24 bits of the fraction, as many as a float holds, converted from a signed
+// integer since that is one instruction on every x86
+static inline float cursorFraction(uint64_t cursor)
+{
+	return (int32_t)((uint32_t)cursor >> 8) * (1.0f / 16777216.0f);
+}
+
+static inline float toFloat(int16_t sample)
+{
+	return sample * (1.0f / 32768.0f);
+}
+
+static inline float toFloat(uint8_t sample)
+{
+	return ((int)sample - 128) * (1.0f / 128.0f);
+}
+
+static inline float readSample(const MixerVoice* voice, unsigned int frame, unsigned int channel)
+{
+	size_t index = (size_t)frame * voice->channels + channel;
+
+	if (voice->sampleFormat == OPEN_HASF_SIGNED_16PCM)
+		return toFloat(((const int16_t*)voice->data)[index]);
+
+	return toFloat(voice->data[index]);
+}
+
+// Buses of the FX slots the voice sends to, from offset on. A slot's bus is cleared
+// when the first voice of the period sends to it.
+static void fxBuses(const MixerVoice* voice, unsigned int offset, float** bus)
+{
+	for (unsigned int i = 0; i < voice->fxSlotCount; i++)
+	{
+		unsigned int slot = voice->fxSlots[i];
+
+		if (!g_fxFed[slot])
+		{
+			memset(g_fxBus[slot], 0, g_renderFrames * sizeof(float));
+			g_fxFed[slot] = true;
+		}
+
+		bus[i] = g_fxBus[slot] + offset;
+	}
+}
+
+// Source rate matches the device and the cursor sits on a frame, so whole runs of
+// frames can be converted and accumulated straight from the buffer.
+static bool mixDirect(MixerVoice* voice, unsigned int startFrame, unsigned int endFrame, unsigned int frames)
+{
+	unsigned int channels = voice->channels;
+	unsigned int index = cursorFrame(voice->cursor);
+	unsigned int i = 0;
+
+	while (i < frames)
+	{
+		unsigned int count = frames - i;
+		if (count > endFrame - index)
+			count = endFrame - index;
+
+		float* bus[MIXER_MAX_CHANNELS];
+		for (unsigned int out = 0; out < g_mixerChannels; out++)
+		{
+			bus[out] = g_mixBus[out] + i;
+		}
+
+		if (voice->sampleFormat == OPEN_HASF_SIGNED_16PCM)
+			g_kernels->mixS16(bus, g_mixerChannels, (const int16_t*)voice->data + (size_t)index * channels, channels, voice->gains, count);
+		else
+			g_kernels->mixU8(bus, g_mixerChannels, voice->data + (size_t)index * channels, channels, voice->gains, count);
+
+		if (voice->fxSlotCount != 0)
+		{
+			float* fx[MIXER_FX_SLOTS];
+			fxBuses(voice, i, fx);
+
+			if (voice->sampleFormat == OPEN_HASF_SIGNED_16PCM)
+				g_kernels->mixS16(fx, voice->fxSlotCount, (const int16_t*)voice->data + (size_t)index * channels, channels, voice->fxGains, count);
+			else
+				g_kernels->mixU8(fx, voice->fxSlotCount, voice->data + (size_t)index * channels, channels, voice->fxGains, count);
+		}
+
+		i += count;
+		index += count;
+
+		if (index >= endFrame)
+		{
+			if (!voice->loop)
+			{
+				voice->cursor = frameCursor(endFrame);
+				return false;
+			}
+
+			index = startFrame;
+			voice->wraps++;
+			voice->looped = true;
+		}
+	}
+
+	voice->cursor = frameCursor(index);
+	return true;
+}
+
+// One channel of linear interpolation between the frame pairs of a block
+template<typename T>
+static void interpolateLinear(float* output, const T* data, unsigned int count)
+{
+	for (unsigned int i = 0; i < count; i++)
+	{
+		float a = toFloat(data[g_runOffsets[i]]);
+		float b = toFloat(data[g_runNext[i]]);
+		output[i] = a + (b - a) * g_runFractions[i];
+	}
+}
+
+// Linear interpolation into the scratch channels. Positions of a block are stepped first
+// and every channel interpolated at them after, so the inner loops carry no cursor
+// arithmetic. Produced is how many frames were written before a one-shot ran out.
+static bool renderLinear(MixerVoice* voice, unsigned int startFrame, unsigned int endFrame, unsigned int frames, uint64_t step, unsigned int* produced)
+{
+	unsigned int channels = voice->channels;
+	uint64_t pos = voice->cursor;
+	uint64_t end = frameCursor(endFrame);
+	uint64_t loopLength = frameCursor(endFrame - startFrame);
+	unsigned int done = 0;
+	bool active = true;
+
+	while (done < frames && active)
+	{
+		unsigned int count = frames - done;
+		if (count > MIXER_FILTER_BLOCK)
+			count = MIXER_FILTER_BLOCK;
+
+		for (unsigned int i = 0; i < count; i++)
+		{
+			unsigned int index = cursorFrame(pos);
+			unsigned int next = index + 1;
+
+			if (next >= endFrame)
+				next = voice->loop ? startFrame : index;
+
+			g_runOffsets[i] = index * channels;
+			g_runNext[i] = next * channels;
+			g_runFractions[i] = cursorFraction(pos);
+
+			pos += step;
+
+			if (pos >= end)
+			{
+				if (!voice->loop)
+				{
+					pos = end;
+					count = i + 1;
+					active = false;
+					break;
+				}
+
+				while (pos >= end)
+				{
+					pos -= loopLength;
+					voice->wraps++;
+					voice->looped = true;
+				}
+			}
+		}
+
+		for (unsigned int ch = 0; ch < channels; ch++)
+		{
+			if (voice->sampleFormat == OPEN_HASF_SIGNED_16PCM)
+				interpolateLinear(g_voiceScratch[ch] + done, (const int16_t*)voice->data + ch, count);
+			else
+				interpolateLinear(g_voiceScratch[ch] + done, voice->data + ch, count);
+		}
+
+		done += count;
+	}
+
+	voice->cursor = pos;
+	*produced = done;
+	return active;
+}
+
+template<typename T>
+static void convertFrames(float* output, const T* data, unsigned int channels, unsigned int channel, unsigned int frame, unsigned int count)
+{
+	const T* src = data + (size_t)frame * channels + channel;
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		output[i] = toFloat(src[(size_t)i * channels]);
+	}
+}
+
+// Source frame at an unrolled position: past the loop end playback continues at the
+// loop start, and before the loop start of a voice that went round already is the
+// loop's tail. Past the end of a one-shot and before the data is silence.
+static float unrolledSample(const MixerVoice* voice, unsigned int channel, int64_t frame, unsigned int startFrame, unsigned int endFrame)
+{
+	int64_t loopLength = endFrame - startFrame;
+
+	if (frame >= endFrame)
+	{
+		if (!voice->loop)
+			return 0.0f;
+
+		frame = startFrame + (frame - endFrame) % loopLength;
+	}
+	else if (frame < startFrame && voice->loop && voice->looped)
+	{
+		frame = endFrame - 1 - (startFrame - 1 - frame) % loopLength;
+	}
+
+	return frame < 0 ? 0.0f : readSample(voice, (unsigned int)frame, channel);
+}
+
+// Converts source frames from runStart on into g_sourceRun. Only the few around a seam
+// or an end need unrolledSample, the rest are read straight from the data.
+static void fillRun(const MixerVoice* voice, unsigned int channel, int64_t runStart, unsigned int length, unsigned int startFrame, unsigned int endFrame)
+{
+	int64_t runEnd = runStart + length;
+	int64_t first = voice->loop && voice->looped ? startFrame : 0;
+	int64_t last = endFrame;
+	unsigned int i = 0;
+
+	if (first < runStart)
+		first = runStart;
+	if (last > runEnd)
+		last = runEnd;
+
+	for (; i < length && runStart + i < first; i++)
+	{
+		g_sourceRun[i] = unrolledSample(voice, channel, runStart + i, startFrame, endFrame);
+	}
+
+	if (first < last)
+	{
+		if (voice->sampleFormat == OPEN_HASF_SIGNED_16PCM)
+			convertFrames(g_sourceRun + i, (const int16_t*)voice->data, voice->channels, channel, (unsigned int)first, (unsigned int)(last - first));
+		else
+			convertFrames(g_sourceRun + i, voice->data, voice->channels, channel, (unsigned int)first, (unsigned int)(last - first));
+
+		i = (unsigned int)(last - runStart);
+	}
+
+	for (; i < length; i++)
+	{
+		g_sourceRun[i] = unrolledSample(voice, channel, runStart + i, startFrame, endFrame);
+	}
+}
+
+// Nearest, cubic and sinc resampling into the scratch channels. Positions within a block
+// count on past the loop end instead of wrapping, and fillRun lays out the source under
+// them the same way, so the filters read straight across seams without checking for them.
+static bool renderFiltered(MixerVoice* voice, unsigned int startFrame, unsigned int endFrame, unsigned int frames, uint64_t step, unsigned int* produced)
+{
+	unsigned int channels = voice->channels;
+	unsigned int taps = g_resampler == RESAMPLER_NEAREST ? 2 : g_resampler == RESAMPLER_CUBIC ? 4 : resamplerTaps();
+	int left = (int)taps / 2 - 1; // frames read before the one under the position
+
+	const float* table = taps >= 8 ? resamplerTable(cursorFrames(step)) : nullptr;
+	unsigned int blockFrames = (unsigned int)(frameCursor(MIXER_RUN_FRAMES - taps - 1) / (step + 1));
+	if (blockFrames > MIXER_FILTER_BLOCK)
+		blockFrames = MIXER_FILTER_BLOCK;
+
+	uint64_t pos = voice->cursor;
+	uint64_t end = frameCursor(endFrame);
+	uint64_t loopLength = frameCursor(endFrame - startFrame);
+	unsigned int done = 0;
+	bool active = true;
+
+	while (done < frames && active)
+	{
+		unsigned int count = frames - done;
+		if (count > blockFrames)
+			count = blockFrames;
+
+		unsigned int first = cursorFrame(pos);
+
+		for (unsigned int i = 0; i < count; i++)
+		{
+			g_runOffsets[i] = cursorFrame(pos) - first;
+
+			if (table != nullptr)
+			{
+				// The fraction picks a row with its top bits and the blend towards the next row with the rest
+				uint64_t phase = (uint64_t)(uint32_t)pos * RESAMPLER_PHASES;
+				g_runPhases[i] = table + cursorFrame(phase) * taps;
+				g_runFractions[i] = cursorFraction(phase);
+			}
+			else
+			{
+				g_runFractions[i] = cursorFraction(pos);
+			}
+
+			pos += step;
+
+			if (!voice->loop && pos >= end)
+			{
+				pos = end;
+				count = i + 1;
+				active = false;
+				break;
+			}
+		}
+
+		for (unsigned int ch = 0; ch < channels; ch++)
+		{
+			float* output = g_voiceScratch[ch] + done;
+			fillRun(voice, ch, (int64_t)first - left, g_runOffsets[count - 1] + taps, startFrame, endFrame);
+
+			if (table != nullptr)
+			{
+				g_kernels->convolve(output, g_sourceRun, g_runOffsets, g_runPhases, g_runFractions, taps, count);
+			}
+			else if (g_resampler == RESAMPLER_NEAREST)
+			{
+				for (unsigned int i = 0; i < count; i++)
+				{
+					output[i] = g_sourceRun[g_runOffsets[i] + (g_runFractions[i] >= 0.5f ? 1 : 0)];
+				}
+			}
+			else
+			{
+				// Catmull-Rom through the two frames either side of the position
+				for (unsigned int i = 0; i < count; i++)
+				{
+					const float* p = g_sourceRun + g_runOffsets[i];
+					float t = g_runFractions[i];
+
+					output[i] = p[1] + 0.5f * t * (p[2] - p[0] + t * (2.0f * p[0] - 5.0f * p[1] + 4.0f * p[2] - p[3] + t * (3.0f * (p[1] - p[2]) + p[3] - p[0])));
+				}
+			}
+		}
+
+		done += count;
+
+		while (voice->loop && pos >= end)
+		{
+			pos -= loopLength;
+			voice->wraps++;
+			voice->looped = true;
+		}
+	}
+
+	voice->cursor = pos;
+	*produced = done;
+	return active;
+}
+
+// Accumulates the first frames of the scratch channels into the bus from offset on
+static void mixScratch(MixerVoice* voice, unsigned int offset, unsigned int frames)
+{
+	float* bus[MIXER_MAX_CHANNELS];
+	for (unsigned int out = 0; out < g_mixerChannels; out++)
+	{
+		bus[out] = g_mixBus[out] + offset;
+	}
+
+	for (unsigned int ch = 0; ch < voice->channels; ch++)
+	{
+		g_kernels->mixF32(bus, g_mixerChannels, g_voiceScratch[ch], voice->gains + ch * g_mixerChannels, frames);
+	}
+
+	if (voice->fxSlotCount != 0)
+	{
+		float* fx[MIXER_FX_SLOTS];
+		fxBuses(voice, offset, fx);
+
+		for (unsigned int ch = 0; ch < voice->channels; ch++)
+		{
+			g_kernels->mixF32(fx, voice->fxSlotCount, g_voiceScratch[ch], voice->fxGains + ch * voice->fxSlotCount, frames);
+		}
+	}
+}
+
+static void queueEvent(MixerVoice* voice, OPEN_HAWOSMESSAGETYPE message)
+{
+	if (voice->callback == nullptr)
+		return;
+
+	CallbackEvent event;
+	event.handle = voice->handle;
+	event.callback = voice->callback;
+	event.message = message;
+
+	if (callbackPost(event))
+		g_eventCount++;
+}
+
+// Notifies once for every notification point the cursor went over since start, and
+// once per period when the frames played add up to another notification interval.
+static void checkNotifications(MixerVoice* voice, double start, unsigned int startFrame, unsigned int endFrame)
+{
+	double end = cursorFrames(voice->cursor);
+	unsigned int wraps = voice->wraps;
+
+	for (unsigned int i = 0; i < voice->notifyPointCount; i++)
+	{
+		double point = voice->notifyPoints[i];
+		bool crossed;
+
+		// Having wrapped, the cursor played from start to the loop end, maybe round the
+		// whole loop a few more times, then from the loop start up to where it is now
+		if (wraps == 0)
+			crossed = point >= start && point < end;
+		else
+			crossed = (point >= start && point < endFrame) || (point >= startFrame && (point < end || (wraps > 1 && point < endFrame)));
+
+		if (crossed)
+			queueEvent(voice, OPEN_HAWOS_NOTIFY);
+	}
+
+	if (voice->notifyInterval != 0)
+	{
+		voice->notifyProgress += end - start + (double)wraps * (endFrame - startFrame);
+
+		if (voice->notifyProgress >= voice->notifyInterval)
+		{
+			voice->notifyProgress = fmod(voice->notifyProgress, (double)voice->notifyInterval);
+			queueEvent(voice, OPEN_HAWOS_NOTIFY);
+		}
+	}
+}
+
+// Moves a voice along as far as mixing it would have, without reading a sample. The
+// cursor ends up exactly where stepping it frame by frame leaves it, so a voice that
+// becomes audible again carries on at the right sample.
+static bool advanceVoice(MixerVoice* voice, unsigned int startFrame, unsigned int endFrame, unsigned int frames, uint64_t step)
+{
+	uint64_t end = frameCursor(endFrame);
+	uint64_t pos = voice->cursor + step * frames;
+
+	if (pos < end)
+	{
+		voice->cursor = pos;
+		return true;
+	}
+
+	if (!voice->loop)
+	{
+		voice->cursor = end;
+		return false;
+	}
+
+	uint64_t loopLength = frameCursor(endFrame - startFrame);
+	uint64_t past = pos - end;
+
+	voice->wraps += (unsigned int)(past / loopLength) + 1;
+	voice->looped = true;
+	voice->cursor = end - loopLength + past % loopLength;
+	return true;
+}
+
+// Resamples into the scratch channels with the configured quality
+static bool renderResampled(MixerVoice* voice, unsigned int startFrame, unsigned int endFrame, unsigned int frames, uint64_t step, unsigned int* produced)
+{
+	if (g_resampler == RESAMPLER_LINEAR)
+		return renderLinear(voice, startFrame, endFrame, frames, step, produced);
+
+	return renderFiltered(voice, startFrame, endFrame, frames, step, produced);
+}
+
+static bool voiceFiltered(const MixerVoice* voice)
+{
+	return voice->filterCutoff < MIXER_MAX_CUTOFF || (voice->synth && (voice->modEnvToCutoff != 0.0f || voice->modLfoToCutoff != 0.0f));
+}
+
+// Low-pass with the cutoff in cents, as tsf_voice_lowpass_setup builds it
+static void lowpassCoefficients(float cents, float qInv, float* coefficients)
+{
+	double k = tan(3.14159265358979323846 * 8.176 * exp2(cents / 1200.0) / g_mixerSampleRate);
+	double kk = k * k;
+	double norm = 1.0 / (1.0 + k * qInv + kk);
+
+	coefficients[0] = (float)(kk * norm);
+	coefficients[1] = (float)(2.0 * (kk - 1.0) * norm);
+	coefficients[2] = (float)((1.0 - k * qInv + kk) * norm);
+}
+
+// Runs the lanes through the low-pass block by block and mixes each into the bus
+static void flushFilters()
+{
+	float state[2 * MIXER_FILTER_LANES] = { 0.0f };
+
+	for (unsigned int lane = 0; lane < g_laneCount; lane++)
+	{
+		state[lane] = g_laneVoices[lane]->filterState[g_laneChannels[lane]][0];
+		state[MIXER_FILTER_LANES + lane] = g_laneVoices[lane]->filterState[g_laneChannels[lane]][1];
+	}
+
+	for (unsigned int done = 0, block = 0; done < g_laneFrames; done += ENVELOPE_BLOCK_FRAMES, block++)
+	{
+		unsigned int count = g_laneFrames - done;
+		if (count > ENVELOPE_BLOCK_FRAMES)
+			count = ENVELOPE_BLOCK_FRAMES;
+
+		g_kernels->lowpass(g_filterLanes + done * MIXER_FILTER_LANES, state, g_filterBlocks[block], count);
+	}
+
+	float* bus[MIXER_MAX_CHANNELS];
+	for (unsigned int out = 0; out < g_mixerChannels; out++)
+	{
+		bus[out] = g_mixBus[out];
+	}
+
+	for (unsigned int lane = 0; lane < g_laneCount; lane++)
+	{
+		MixerVoice* voice = g_laneVoices[lane];
+		unsigned int channel = g_laneChannels[lane];
+
+		voice->filterState[channel][0] = state[lane];
+		voice->filterState[channel][1] = state[MIXER_FILTER_LANES + lane];
+
+		for (unsigned int i = 0; i < g_laneFrames; i++)
+		{
+			g_voiceScratch[0][i] = g_filterLanes[i * MIXER_FILTER_LANES + lane];
+		}
+
+		g_kernels->mixF32(bus, g_mixerChannels, g_voiceScratch[0], voice->gains + channel * g_mixerChannels, g_laneFrames);
+
+		if (voice->fxSlotCount != 0)
+		{
+			float* fx[MIXER_FX_SLOTS];
+			fxBuses(voice, 0, fx);
+			g_kernels->mixF32(fx, voice->fxSlotCount, g_voiceScratch[0], voice->fxGains + channel * voice->fxSlotCount, g_laneFrames);
+		}
+	}
+
+	g_laneCount = 0;
+}
+
+// Takes a lane for every channel of the voice, flushing the ones in use first when
+// there are not enough left. Returns the first, with the voice's frames all silent.
+static unsigned int claimLanes(MixerVoice* voice, unsigned int frames)
+{
+	if (g_laneCount + voice->channels > MIXER_FILTER_LANES)
+		flushFilters();
+
+	if (g_laneCount == 0)
+	{
+		// Lanes nobody claims stay silent with a filter that passes them through
+		memset(g_filterLanes, 0, frames * MIXER_FILTER_LANES * sizeof(float));
+		memset(g_filterBlocks, 0, sizeof(g_filterBlocks));
+		g_laneFrames = frames;
+	}
+
+	unsigned int first = g_laneCount;
+
+	for (unsigned int ch = 0; ch < voice->channels; ch++)
+	{
+		g_laneVoices[g_laneCount] = voice;
+		g_laneChannels[g_laneCount] = ch;
+		g_laneCount++;
+	}
+
+	return first;
+}
+
+// Sets the coefficients a block of the voice's lanes sweeps through, from where the last
+// block ended to the cutoff the modulation is at now
+static void setFilterBlock(MixerVoice* voice, unsigned int lane, unsigned int block, unsigned int count)
+{
+	float cents = voice->filterCutoff + voice->modEnvelope.level * voice->modEnvToCutoff + voice->modLfo.level * voice->modLfoToCutoff;
+	if (cents < MIXER_MIN_CUTOFF) cents = MIXER_MIN_CUTOFF;
+	if (cents > MIXER_MAX_CUTOFF) cents = MIXER_MAX_CUTOFF;
+
+	float target[3];
+	if (cents != voice->filterCents)
+	{
+		lowpassCoefficients(cents, voice->filterQInv, target);
+
+		if (voice->filterCents == 0.0f)
+		{
+			for (int i = 0; i < 3; i++)
+				voice->filterCoefficients[i] = target[i];
+		}
+
+		voice->filterCents = cents;
+	}
+	else
+	{
+		for (int i = 0; i < 3; i++)
+			target[i] = voice->filterCoefficients[i];
+	}
+
+	for (unsigned int ch = 0; ch < voice->channels; ch++)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			g_filterBlocks[block][i * MIXER_FILTER_LANES + lane + ch] = voice->filterCoefficients[i];
+			g_filterBlocks[block][(i + 3) * MIXER_FILTER_LANES + lane + ch] = (target[i] - voice->filterCoefficients[i]) / count;
+		}
+	}
+
+	for (int i = 0; i < 3; i++)
+		voice->filterCoefficients[i] = target[i];
+}
+
+// Synth and filtered voices go through the period a block at a time. Each block a synth
+// voice's envelopes and LFOs are stepped once, the pitch they bend the voice by sets the
+// block's step and the volume envelope's level, attenuated by the modulation LFO, is
+// ramped across the block's frames. A filtered voice's cutoff follows the same blocks,
+// its channels going to filter lanes instead of the bus. Returns false once the volume
+// envelope finished or a one-shot ran out of frames.
+static bool mixBlocks(MixerVoice* voice, bool filtered, unsigned int startFrame, unsigned int endFrame, unsigned int frames, uint64_t step, uint64_t maxStep)
+{
+	bool active = true;
+	unsigned int lane = filtered ? claimLanes(voice, frames) : 0;
+
+	for (unsigned int done = 0; done < frames && active; )
+	{
+		unsigned int count = frames - done;
+		if (count > ENVELOPE_BLOCK_FRAMES)
+			count = ENVELOPE_BLOCK_FRAMES;
+
+		uint64_t blockStep = step;
+		float from = 1.0f;
+		float to = 1.0f;
+
+		if (voice->synth)
+		{
+			float cents = voice->modEnvelope.level * voice->modEnvToPitch +
+				voice->modLfo.level * voice->modLfoToPitch +
+				voice->vibLfo.level * voice->vibLfoToPitch;
+
+			if (cents != 0.0f)
+			{
+				blockStep = (uint64_t)(step * exp2(cents / 1200.0));
+				if (blockStep > maxStep)
+					blockStep = maxStep;
+			}
+
+			from = voice->volumeEnvelope.level * voice->lfoGain;
+
+			envelopeAdvance(&voice->volumeEnvelope, count, g_mixerSampleRate);
+			envelopeAdvance(&voice->modEnvelope, count, g_mixerSampleRate);
+			lfoAdvance(&voice->modLfo, count);
+			lfoAdvance(&voice->vibLfo, count);
+
+			if (voice->modLfoToAttenuation != 0.0f)
+				voice->lfoGain = powf(10.0f, voice->modLfo.level * voice->modLfoToAttenuation / -200.0f);
+
+			to = voice->volumeEnvelope.level * voice->lfoGain;
+		}
+
+		// Kept sweeping through quiet blocks too, so the filter comes back where it should be
+		if (filtered)
+			setFilterBlock(voice, lane, done / ENVELOPE_BLOCK_FRAMES, count);
+
+		if (voice->level * (from > to ? from : to) < g_audibleLevel)
+		{
+			active = advanceVoice(voice, startFrame, endFrame, count, blockStep);
+		}
+		else
+		{
+			unsigned int produced;
+			active = renderResampled(voice, startFrame, endFrame, count, blockStep, &produced);
+
+			for (unsigned int ch = 0; voice->synth && ch < voice->channels; ch++)
+			{
+				g_kernels->applyRamp(g_voiceScratch[ch], from, (to - from) / count, produced);
+			}
+
+			if (filtered)
+			{
+				float* lanes = g_filterLanes + done * MIXER_FILTER_LANES + lane;
+
+				for (unsigned int ch = 0; ch < voice->channels; ch++)
+				{
+					for (unsigned int i = 0; i < produced; i++)
+					{
+						lanes[i * MIXER_FILTER_LANES + ch] = g_voiceScratch[ch][i];
+					}
+				}
+			}
+			else
+			{
+				mixScratch(voice, done, produced);
+			}
+		}
+
+		if (voice->synth && voice->volumeEnvelope.segment == ENVELOPE_DONE)
+			active = false;
+
+		done += count;
+	}
+
+	return active;
+}
+
+// Mixes one voice into the bus, or only advances it when it is too quiet to hear.
+// Returns false once a non-looping voice reached its end.
+static bool mixVoice(MixerVoice* voice, unsigned int frames)
+{
+	unsigned int blockAlign = voice->blockAlign;
+	unsigned int totalFrames = voice->totalFrames;
+
+	// Same play region updateBufferNew used to upload to DirectSound
+	unsigned int startFrame = voice->startLoop / blockAlign;
+	unsigned int endFrame = (voice->loop ? voice->endLoop : voice->endOffset) / blockAlign;
+
+	if (startFrame >= totalFrames) startFrame = 0;
+	if (endFrame > totalFrames) endFrame = totalFrames;
+	// An empty loop plays on to the end of the buffer, a one-shot always stops at its end
+	// offset, wherever the loop start is
+	if (voice->loop && endFrame <= startFrame) endFrame = totalFrames;
+
+	if (voice->channels == 0 || voice->channels > MIXER_MAX_SOURCE_CHANNELS)
+		return false;
+
+	if (cursorFrame(voice->cursor) >= endFrame)
+	{
+		if (!voice->loop)
+			return false;
+		voice->cursor = frameCursor(startFrame);
+	}
+
+	// Rounded to the nearest 2^-32 frame, which is the only rounding a voice's
+	// position ever goes through
+	uint64_t step = (uint64_t)((double)voice->sampleRate * voice->frequency / g_mixerSampleRate * 4294967296.0 + 0.5);
+
+	// Rates past what a voice may play at would not fit a filter block in its run
+	uint64_t maxStep = frameCursor(MIXER_MAX_VOICE_RATE) / g_mixerSampleRate;
+	if (step > maxStep)
+		step = maxStep;
+
+	double start = cursorFrames(voice->cursor);
+	bool active;
+
+	voice->wraps = 0;
+
+	// A voice that goes unfiltered for a while starts over when it is filtered again
+	bool filtered = voiceFiltered(voice) && voice->level >= g_audibleLevel;
+	if (!filtered && voice->filterCents != 0.0f)
+	{
+		memset(voice->filterState, 0, sizeof(voice->filterState));
+		voice->filterCents = 0.0f;
+	}
+
+	if (voice->synth || filtered)
+		active = mixBlocks(voice, filtered, startFrame, endFrame, frames, step, maxStep);
+	else if (voice->level < g_audibleLevel)
+		active = advanceVoice(voice, startFrame, endFrame, frames, step);
+	else if (step == frameCursor(1) && (uint32_t)voice->cursor == 0)
+		active = mixDirect(voice, startFrame, endFrame, frames);
+	else
+	{
+		unsigned int produced;
+		active = renderResampled(voice, startFrame, endFrame, frames, step, &produced);
+		mixScratch(voice, 0, produced);
+	}
+
+	if (voice->notifyPointCount != 0 || voice->notifyInterval != 0)
+		checkNotifications(voice, start, startFrame, endFrame);
+
+	return active;
+}
+
+// Loudest any source channel of the voice reaches on any output, through its envelope
+// when it has one. An envelope still in its delay or attack counts at the peak it is
+// heading for, or a note that has only just started would always be the quietest.
+static float voiceLevel(MixerVoice* voice)
+{
+	if (voice->pendingRouting || voice->routingGeneration != g_routingGeneration)
+		updateRouting(voice);
+
+	if (voice->synth)
+	{
+		const Envelope& envelope = voice->volumeEnvelope;
+		return voice->level * (envelope.segment <= ENVELOPE_ATTACK ? 1.0f : envelope.level);
+	}
+
+	return voice->level;
+}
+
+static bool weakerVoice(MixerVoice* a, MixerVoice* b)
+{
+	if (a->priority != b->priority)
+		return a->priority < b->priority;
+
+	return voiceLevel(a) < voiceLevel(b);
+}
+
+// Makes room for a voice that took the active list past the budget, by stopping the
+// lowest priority voice and of those the quietest. The voice that just started is only
+// the one stopped when it is weaker than all the others, so a newer sound wins a tie.
+static void stealVoice(MixerVoice* started)
+{
+	MixerVoice* victim = nullptr;
+
+	for (MixerVoice* voice : g_activeVoices)
+	{
+		if (voice != started && (victim == nullptr || weakerVoice(voice, victim)))
+			victim = voice;
+	}
+
+	if (victim == nullptr || weakerVoice(started, victim))
+		victim = started;
+
+	info("stealVoice: Voice budget of %d reached, stopping %08X (priority %d)", g_maxVoices, victim, victim->priority);
+
+	stopVoice(victim);
+	victim->finishedSerial.store(victim->playSerial, std::memory_order_release);
+	queueEvent(victim, OPEN_HAWOS_RESOURCE_STOLEN);
+}
+
+
+static void applyCommand(const MixerCommand& command)
+{
+	MixerVoice* voice = command.voice;
+
+	switch (command.type)
+	{
+	case MIXER_CMD_PLAY:
+	{
+		// A voice that is still being mixed just keeps going, anything else restarts
+		// from the loop start unless it was paused or positioned explicitly. A synth
+		// voice playing out its release counts as stopped.
+		bool restart = (voice->activeIndex < 0 || voice->releasing) && !voice->paused;
+
+		if (restart && !voice->positionSet)
+		{
+			voice->cursor = frameCursor(voice->startLoop / voice->blockAlign);
+			voice->looped = false;
+			voice->notifyProgress = 0.0;
+		}
+
+		if (restart && voice->synth)
+		{
+			envelopeStart(&voice->volumeEnvelope, g_mixerSampleRate);
+			envelopeStart(&voice->modEnvelope, g_mixerSampleRate);
+			lfoStart(&voice->modLfo, g_mixerSampleRate);
+			lfoStart(&voice->vibLfo, g_mixerSampleRate);
+			voice->lfoGain = 1.0f;
+		}
+
+		if (restart)
+		{
+			memset(voice->filterState, 0, sizeof(voice->filterState));
+			voice->filterCents = 0.0f;
+		}
+
+		info("applyCommand: Voice %08X playing from frame %d", voice, cursorFrame(voice->cursor));
+
+		voice->playSerial = (unsigned int)command.param;
+		voice->paused = false;
+		voice->positionSet = false;
+		voice->releasing = false;
+		voice->position.store(cursorFrame(voice->cursor), std::memory_order_relaxed);
+
+		if (voice->activeIndex < 0)
+		{
+			startVoice(voice);
+
+			if (g_maxVoices != 0 && g_activeVoices.size() > g_maxVoices)
+				stealVoice(voice);
+		}
+		break;
+	}
+	case MIXER_CMD_STOP:
+		stopVoice(voice);
+		voice->paused = false;
+		voice->positionSet = false;
+		voice->releasing = false;
+		break;
+	case MIXER_CMD_PAUSE:
+		stopVoice(voice);
+		voice->paused = true;
+		break;
+	case MIXER_CMD_RETIRE:
+		stopVoice(voice);
+		voice->retired.store(true, std::memory_order_release);
+		break;
+	case MIXER_CMD_SET_SEND:
+		voice->sendRoutes[command.index] = command.param;
+		voice->sendChannels[command.index] = command.channel;
+		voice->sendVolumes[command.index] = command.value;
+		voice->pendingRouting = true;
+		break;
+	case MIXER_CMD_SET_CHANNEL_VOLUME:
+		voice->channelVolumes[command.index] = command.value;
+		voice->pendingRouting = true;
+		break;
+	case MIXER_CMD_SET_MASTER_VOLUME:
+		voice->masterVolume = command.value;
+		voice->pendingRouting = true;
+		break;
+	case MIXER_CMD_SET_RATE:
+		voice->sampleRate = (unsigned int)command.param;
+		voice->frequency = command.value;
+		break;
+	case MIXER_CMD_SET_LOOP_STATE:
+		voice->loop = command.param != 0;
+		break;
+	case MIXER_CMD_SET_START_LOOP:
+		voice->startLoop = (unsigned int)command.param;
+		break;
+	case MIXER_CMD_SET_END_LOOP:
+		voice->endLoop = (unsigned int)command.param;
+		break;
+	case MIXER_CMD_SET_END_OFFSET:
+		voice->endOffset = (unsigned int)command.param;
+		break;
+	case MIXER_CMD_SET_POSITION:
+		voice->cursor = frameCursor((unsigned int)command.param);
+		voice->looped = false;
+		voice->positionSet = voice->activeIndex < 0;
+		voice->position.store((unsigned int)command.param, std::memory_order_relaxed);
+		break;
+	case MIXER_CMD_SET_NOTIFY_POINT:
+	{
+		unsigned int frame = (unsigned int)command.param;
+		unsigned int i = 0;
+
+		while (i < voice->notifyPointCount && voice->notifyPoints[i] < frame)
+			i++;
+
+		if (i < voice->notifyPointCount && voice->notifyPoints[i] == frame)
+			break;
+		if (voice->notifyPointCount == MIXER_MAX_NOTIFY_POINTS)
+			break;
+
+		memmove(voice->notifyPoints + i + 1, voice->notifyPoints + i, (voice->notifyPointCount - i) * sizeof(unsigned int));
+		voice->notifyPoints[i] = frame;
+		voice->notifyPointCount++;
+		break;
+	}
+	case MIXER_CMD_CLEAR_NOTIFY_POINT:
+		for (unsigned int i = 0; i < voice->notifyPointCount; i++)
+		{
+			if (voice->notifyPoints[i] == (unsigned int)command.param)
+			{
+				voice->notifyPointCount--;
+				memmove(voice->notifyPoints + i, voice->notifyPoints + i + 1, (voice->notifyPointCount - i) * sizeof(unsigned int));
+				break;
+			}
+		}
+		break;
+	case MIXER_CMD_SET_NOTIFY_INTERVAL:
+		voice->notifyInterval = (unsigned int)command.param;
+		voice->notifyProgress = 0.0;
+		break;
+	case MIXER_CMD_SET_PRIORITY:
+		voice->priority = (unsigned int)command.param;
+		break;
+	case MIXER_CMD_SET_SYNTH_PARAM:
+		// Envelope times and levels take effect from the next segment the voice enters,
+		// LFO delays and rates from the next play
+		if (command.index >= OPEN_HAVP_DELAY_VOL_ENV && command.index <= OPEN_HAVP_RELEASE_VOL_ENV)
+			envelopeSetParameter(&voice->volumeEnvelope, command.index - OPEN_HAVP_DELAY_VOL_ENV, command.value);
+		else if (command.index >= OPEN_HAVP_DELAY_MOD_ENV && command.index <= OPEN_HAVP_RELEASE_MOD_ENV)
+			envelopeSetParameter(&voice->modEnvelope, command.index - OPEN_HAVP_DELAY_MOD_ENV, command.value);
+		else if (command.index == OPEN_HAVP_MOD_ENV_TO_PITCH)
+			voice->modEnvToPitch = command.value;
+		else if (command.index == OPEN_HAVP_DELAY_MOD_LFO)
+			voice->modLfo.delay = command.value;
+		else if (command.index == OPEN_HAVP_FREQ_MOD_LFO)
+			voice->modLfo.frequency = command.value;
+		else if (command.index == OPEN_HAVP_DELAY_VIB_LFO)
+			voice->vibLfo.delay = command.value;
+		else if (command.index == OPEN_HAVP_FREQ_VIB_LFO)
+			voice->vibLfo.frequency = command.value;
+		else if (command.index == OPEN_HAVP_MOD_LFO_TO_PITCH)
+			voice->modLfoToPitch = command.value;
+		else if (command.index == OPEN_HAVP_VIB_LFO_TO_PITCH)
+			voice->vibLfoToPitch = command.value;
+		else if (command.index == OPEN_HAVP_MOD_LFO_TO_ATTENUATION)
+			voice->modLfoToAttenuation = command.value;
+		else if (command.index == OPEN_HAVP_FILTER_CUTOFF)
+			voice->filterCutoff = command.value;
+		else if (command.index == OPEN_HAVP_FILTER_Q)
+		{
+			// A new Q at the same cutoff still needs its coefficients rebuilt
+			voice->filterQInv = command.value;
+			if (voice->filterCents != 0.0f)
+				voice->filterCents = -1.0f;
+		}
+		else if (command.index == OPEN_HAVP_MOD_ENV_TO_FILTER_CUTOFF)
+			voice->modEnvToCutoff = command.value;
+		else if (command.index == OPEN_HAVP_MOD_LFO_TO_FILTER_CUTOFF)
+			voice->modLfoToCutoff = command.value;
+		break;
+	case MIXER_CMD_RELEASE:
+		if (voice->activeIndex >= 0 && voice->synth)
+		{
+			envelopeRelease(&voice->volumeEnvelope, g_mixerSampleRate);
+			envelopeRelease(&voice->modEnvelope, g_mixerSampleRate);
+			voice->releasing = true;
+		}
+		break;
+	case MIXER_CMD_SET_FX_PARAM:
+		if (command.index >= MIXER_FX_SLOTS)
+			break;
+
+		if (command.param == EAXFXSLOT_LOADEFFECT)
+		{
+			// A freshly loaded effect starts from its defaults, and voices drop or pick
+			// up their sends to the slot with the next period
+			reverbInit(&g_fxReverbs[command.index], g_mixerSampleRate);
+			g_fxLoaded[command.index] = command.value != 0.0f;
+			g_routingGeneration++;
+		}
+		else
+		{
+			reverbSetParameter(&g_fxReverbs[command.index], (unsigned int)command.param, command.value);
+		}
+		break;
+	case MIXER_CMD_SET_FX_RETURN:
+		g_fxReturnPort = command.param;
+		break;
+	case MIXER_CMD_SET_IO_VOLUME:
+		// Every voice picks up the new volume before it is mixed next
+		if (command.index < MIXER_PORTS)
+		{
+			g_ioVolumes[command.index] = command.value;
+			g_routingGeneration++;
+		}
+		break;
+	}
+}
+
+// Runs the reverb of every slot that was sent to this period or still rings, and adds
+// its output to the ports it returns to
+static void renderFxSlots(unsigned int frames)
+{
+	float* bus[MIXER_MAX_CHANNELS];
+	for (unsigned int out = 0; out < g_mixerChannels; out++)
+	{
+		bus[out] = g_mixBus[out];
+	}
+
+	for (int slot = 0; slot < MIXER_FX_SLOTS; slot++)
+	{
+		const float* input = g_fxFed[slot] ? g_fxBus[slot] : nullptr;
+		g_fxFed[slot] = false;
+
+		if (!g_fxLoaded[slot] || !reverbProcess(&g_fxReverbs[slot], g_kernels, input, g_voiceScratch[0], g_voiceScratch[1], frames))
+			continue;
+
+		for (int side = 0; side < 2; side++)
+		{
+			int port = g_fxReturnPort + side;
+			float gains[MIXER_MAX_CHANNELS];
+
+			for (unsigned int out = 0; out < g_mixerChannels; out++)
+			{
+				gains[out] = g_foldDown[port][out] * g_ioVolumes[port];
+			}
+
+			g_kernels->mixF32(bus, g_mixerChannels, g_voiceScratch[side], gains, frames);
+		}
+	}
+}
+
+static void applyCommands()
+{
+	g_commands.drain(applyCommand);
+}
+
+static void lockMixer()
+{
+	while (g_mixerBusy.test_and_set(std::memory_order_acquire))
+	{
+		std::this_thread::yield();
+	}
+}
+
+static void unlockMixer()
+{
+	g_mixerBusy.clear(std::memory_order_release);
+}
+
+// Applies the queue unless the mixer holds it, returns whether it did
+static bool tryApplyCommands()
+{
+	if (g_mixerBusy.test_and_set(std::memory_order_acquire))
+		return false;
+
+	applyCommands();
+	unlockMixer();
+	return true;
+}
+
+void mixerSubmit(const MixerCommand* commands, unsigned int count)
+{
+	while (!g_commands.push(commands, count))
+	{
+		// Full. When the mixer is stalled, or only runs when the host renders, make
+		// room by applying the queue here instead of waiting on it.
+		if (!tryApplyCommands())
+			std::this_thread::yield();
+	}
+}
+
+void mixerFlush()
+{
+	lockMixer();
+	applyCommands();
+	unlockMixer();
+}
+
+void mixerTryFlush()
+{
+	tryApplyCommands();
+}
+
+void mixerRender(int16_t* output, unsigned int frames)
+{
+	if (frames > MIXER_MAX_PERIOD_FRAMES)
+		frames = MIXER_MAX_PERIOD_FRAMES;
+
+	for (unsigned int out = 0; out < g_mixerChannels; out++)
+	{
+		memset(g_mixBus[out], 0, frames * sizeof(float));
+	}
+
+	lockMixer();
+	applyCommands();
+
+	g_renderFrames = frames;
+
+	// Walk backwards so finished voices can be swap-removed in place
+	for (int i = (int)g_activeVoices.size() - 1; i >= 0; i--)
+	{
+		MixerVoice* voice = g_activeVoices[i];
+
+		// However many routing calls came in since the last period, gains are built once
+		if (voice->pendingRouting || voice->routingGeneration != g_routingGeneration)
+			updateRouting(voice);
+
+		if (voice->data == nullptr || !mixVoice(voice, frames))
+		{
+			info("mixerRender: Voice %08X reached its end", voice);
+			stopVoice(voice);
+			voice->finishedSerial.store(voice->playSerial, std::memory_order_release);
+			queueEvent(voice, OPEN_HAWOS_NOTIFY);
+		}
+
+		voice->position.store(cursorFrame(voice->cursor), std::memory_order_relaxed);
+	}
+
+	// Whatever filtered voices did not fill a batch of lanes
+	if (g_laneCount != 0)
+		flushFilters();
+
+	renderFxSlots(frames);
+
+	// Including any a producer raised applying commands since the last period
+	bool deliver = g_eventCount != 0;
+	g_eventCount = 0;
+
+	unlockMixer();
+
+	// Delivered with the mixer free again, so a callback made right here can still
+	// queue commands without waiting on itself
+	if (deliver)
+		callbackDeliver();
+
+	const float* bus[MIXER_MAX_CHANNELS];
+	for (unsigned int out = 0; out < g_mixerChannels; out++)
+	{
+		bus[out] = g_mixBus[out];
+	}
+
+	g_kernels->outputS16(output, bus, g_mixerChannels, frames);
+}
@@ -0,0 +1,195 @@
+/*
+* This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+*
+* See LICENSE and MENTIONS in the root of the source tree for information
+* regarding licensing.
+*/
+#pragma once
+
+extern "C" {
+#include "opensegaapi.h"
+}
+
+#include "envelope.h"
+#include "lfo.h"
+
+#include <stdint.h>
+#include <atomic>
+
+// Format of the single stream handed to the output device. Every voice is
+// resampled and mixed into it, so the device never sees individual buffers.
+#define MIXER_SAMPLE_RATE 48000
+#define MIXER_MAX_CHANNELS 6
+#define MIXER_PERIOD_FRAMES 480
+#define MIXER_MAX_PERIOD_FRAMES 4096
+
+// Widest source buffer a voice can mix
+#define MIXER_MAX_SOURCE_CHANNELS 6
+
+// Voices are routed to the six SEGA output ports, numbered like OPEN_HA_*_PORT
+// (front left/right, center, LFE, rear left/right). The device layout decides
+// how these fold down to the channels actually output.
+#define MIXER_PORTS 6
+
+// Sends can also go to the four FX slots, OPEN_HA_FXSLOT0_PORT on. Each runs a reverb
+// whose stereo output returns to the front or rear left and right ports.
+#define MIXER_FX_SLOTS 4
+
+// Voice playback rates are clamped to this range after pitch is applied
+#define MIXER_MIN_VOICE_RATE 100
+#define MIXER_MAX_VOICE_RATE 200000
+
+// Output frames the filtered resamplers work out at a time, and the most source frames
+// one such block can read
+#define MIXER_FILTER_BLOCK 256
+#define MIXER_RUN_FRAMES 2048
+
+// Range voice filter cutoffs are kept in, absolute cents (8.176 Hz at 0) like the SF2
+// parameters. At the top, about 20 kHz, a voice with no cutoff modulation is not
+// filtered at all.
+#define MIXER_MIN_CUTOFF 1500
+#define MIXER_MAX_CUTOFF 13500
+
+// Voices mixed at once unless OPENSEGAAPI_MAXVOICES says otherwise, see mixerInit
+#define MIXER_DEFAULT_MAX_VOICES 256
+
+// Voices whose gains all stay below this are not mixed, only moved along, unless
+// OPENSEGAAPI_AUDIBLEDB says otherwise. At -90dB a full scale source is under one
+// step of the 16-bit output.
+#define MIXER_DEFAULT_AUDIBLE_DB -90.0
+
+// Commands the mixer takes in at the start of a period, see mixerSubmit
+#define MIXER_COMMAND_CAPACITY 4096
+
+// Notification points one voice can have set at a time
+#define MIXER_MAX_NOTIFY_POINTS 16
+
+// What the mixer needs to play one buffer. After the buffer is created only the mixer
+// writes to it, everything else arrives as commands and goes back out through the
+// published fields at the end.
+struct MixerVoice
+{
+	// Fixed when the buffer is created
+	void* handle;             // passed to the callback
+	OPEN_HAWOSEGABUFFERCALLBACK callback;
+	const uint8_t* data;
+	unsigned int channels;
+	unsigned int sampleFormat;
+	unsigned int blockAlign;
+	unsigned int totalFrames;
+	bool synth;               // OPEN_HABUF_SYNTH_BUFFER, played through its envelopes
+
+	// Parameters, copies of what the game set
+	bool loop;
+	unsigned int startLoop;   // byte offsets into data
+	unsigned int endLoop;
+	unsigned int endOffset;
+	unsigned int sampleRate;
+	float frequency;          // multiplier on sampleRate
+	int sendRoutes[7];
+	int sendChannels[7];
+	float sendVolumes[7];
+	float channelVolumes[6];
+	float masterVolume;
+	unsigned int priority;    // higher is more important, see stealVoice
+	unsigned int notifyPoints[MIXER_MAX_NOTIFY_POINTS]; // frames, ascending
+	unsigned int notifyPointCount;
+	unsigned int notifyInterval; // frames between periodic notifications, 0 for none
+	float modEnvToPitch;      // cents the modulation envelope bends the pitch by at its peak
+	float modLfoToPitch;      // cents at the LFO peaks
+	float vibLfoToPitch;
+	float modLfoToAttenuation; // centibels at the LFO peaks
+	float filterCutoff;       // cents, MIXER_MAX_CUTOFF when not filtered
+	float filterQInv;         // 1 / Q of the low-pass
+	float modEnvToCutoff;     // cents the cutoff moves by at the modulation envelope's peak
+	float modLfoToCutoff;     // and at the modulation LFO's
+
+	// Playback state
+	uint64_t cursor;          // read position from the start of data, frames in 32.32 fixed point
+	bool paused;              // stopped by a pause, the next play resumes at cursor
+	bool positionSet;         // positioned while stopped, the next play starts at cursor
+	int activeIndex;          // slot in the active voice list, -1 if not mixed
+	unsigned int playSerial;  // of the play command that started the current run
+	unsigned int wraps;       // times the cursor went round the loop this period
+	bool looped;              // went round the loop since it started, so the loop's tail precedes its start
+	double notifyProgress;    // frames played towards the next periodic notification
+	bool pendingRouting;      // sends changed, gains are rebuilt before the next period
+	unsigned int routingGeneration; // IO volume state the gains were built from
+	float gains[MIXER_MAX_SOURCE_CHANNELS * MIXER_MAX_CHANNELS]; // [channel * output channels + output]
+	float fxGains[MIXER_MAX_SOURCE_CHANNELS * MIXER_FX_SLOTS]; // [channel * fxSlotCount + i], to fxSlots[i]
+	unsigned int fxSlots[MIXER_FX_SLOTS]; // FX slots the voice sends anything to
+	unsigned int fxSlotCount;
+	float level;              // largest of the gains
+	Envelope volumeEnvelope;  // synth voices only, parameters included
+	Envelope modEnvelope;
+	Lfo modLfo;               // parameters included
+	Lfo vibLfo;
+	float lfoGain;            // modulation LFO's attenuation where the last block ended
+	float filterCents;        // cutoff the coefficients are for, 0 to have them rebuilt without a sweep
+	float filterCoefficients[3]; // a0, b1 and b2 where the last block ended
+	float filterState[MIXER_MAX_SOURCE_CHANNELS][2]; // z1 and z2 of each channel
+	bool releasing;           // released, plays until the volume envelope is done
+
+	// Published by the mixer for the API side
+	std::atomic<unsigned int> finishedSerial; // playSerial of the last run that reached its end
+	std::atomic<unsigned int> position;       // cursor in whole frames
+	std::atomic<bool> retired;                // off the active list for good, safe to free
+};
+
+enum MixerCommandType
+{
+	MIXER_CMD_PLAY,               // param: play serial
+	MIXER_CMD_STOP,
+	MIXER_CMD_PAUSE,
+	MIXER_CMD_RETIRE,             // the voice is never referenced again afterwards
+	MIXER_CMD_SET_SEND,           // index: send, param: route, channel: source channel, value: level
+	MIXER_CMD_SET_CHANNEL_VOLUME, // index: channel, value: volume
+	MIXER_CMD_SET_MASTER_VOLUME,  // value: volume
+	MIXER_CMD_SET_RATE,           // param: sample rate, value: frequency multiplier
+	MIXER_CMD_SET_LOOP_STATE,     // param: loop flag
+	MIXER_CMD_SET_START_LOOP,     // param: byte offset
+	MIXER_CMD_SET_END_LOOP,       // param: byte offset
+	MIXER_CMD_SET_END_OFFSET,     // param: byte offset
+	MIXER_CMD_SET_POSITION,       // param: frame
+	MIXER_CMD_SET_IO_VOLUME,      // index: port, value: volume, no voice
+	MIXER_CMD_SET_NOTIFY_POINT,   // param: frame
+	MIXER_CMD_CLEAR_NOTIFY_POINT, // param: frame
+	MIXER_CMD_SET_NOTIFY_INTERVAL, // param: frames, 0 turns it off
+	MIXER_CMD_SET_PRIORITY,       // param: priority
+	MIXER_CMD_SET_SYNTH_PARAM,    // index: OPEN_HAVP_* parameter, value: in seconds, levels, Hz, cents or centibels
+	MIXER_CMD_RELEASE,            // a synth voice goes into the release of its envelopes
+	MIXER_CMD_SET_FX_PARAM,       // index: FX slot, param: EAXREVERB_* or EAXFXSLOT_* property, value: as ReverbParameters has it, no voice
+	MIXER_CMD_SET_FX_RETURN,      // param: left port of the pair FX slots return to, no voice
+};
+
+struct MixerCommand
+{
+	MixerCommandType type;
+	MixerVoice* voice;
+	unsigned int index;
+	int param;
+	int channel;
+	float value;
+};
+
+// Channels is the device layout: 2 (stereo), 4 (quad) or 6 (5.1, in port order).
+// Reads the voice budget from OPENSEGAAPI_MAXVOICES, 0 for no limit, and the level
+// voices must reach to be mixed from OPENSEGAAPI_AUDIBLEDB.
+void mixerInit(unsigned int sampleRate, unsigned int channels);
+unsigned int mixerChannels();
+
+// Queues commands from any thread. The mixer applies them in order at the start of
+// its next period, the commands of one call all in the same period. Only waits when
+// the queue is full.
+void mixerSubmit(const MixerCommand* commands, unsigned int count);
+
+// Applies queued commands now. Only for when no output is running the mixer.
+void mixerFlush();
+
+// Applies queued commands now unless the mixer is busy, in which case its next period
+// does. Never waits.
+void mixerTryFlush();
+
+// Mixes one period of all active voices into interleaved 16-bit samples. Voices that
+// ended or crossed a notification point are handed to callbackDeliver afterwards.
+void mixerRender(int16_t* output, unsigned int frames);
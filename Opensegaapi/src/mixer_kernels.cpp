@@ -0,0 +1,831 @@
+/*
+* This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+*
+* See LICENSE and MENTIONS in the root of the source tree for information
+* regarding licensing.
+*/
+#include "mixer_kernels.h"
+#include "log.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define MIXER_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define MIXER_TARGET(isa)
+#else
+#define MIXER_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+// The SIMD sets do the same multiplies and adds in the same order as these, so
+// their output is bit-identical and can be compared exactly.
+
+static inline float convertSample(uint8_t sample)
+{
+	return ((int)sample - 128) * (1.0f / 128.0f);
+}
+
+static inline float convertSample(int16_t sample)
+{
+	return sample * (1.0f / 32768.0f);
+}
+
+template<typename T>
+static void mixPcmScalar(float* const* bus, unsigned int ports, const T* src, unsigned int channels, const float* gains, unsigned int first, unsigned int frames)
+{
+	for (unsigned int i = first; i < frames; i++)
+	{
+		for (unsigned int ch = 0; ch < channels; ch++)
+		{
+			float sample = convertSample(src[i * channels + ch]);
+
+			for (unsigned int port = 0; port < ports; port++)
+			{
+				bus[port][i] += sample * gains[ch * ports + port];
+			}
+		}
+	}
+}
+
+static void mixF32Scalar(float* const* bus, unsigned int ports, const float* src, const float* gains, unsigned int first, unsigned int frames)
+{
+	for (unsigned int i = first; i < frames; i++)
+	{
+		for (unsigned int port = 0; port < ports; port++)
+		{
+			bus[port][i] += src[i] * gains[port];
+		}
+	}
+}
+
+static void outputS16Scalar(int16_t* output, const float* const* bus, unsigned int ports, unsigned int first, unsigned int frames)
+{
+	for (unsigned int i = first; i < frames; i++)
+	{
+		for (unsigned int port = 0; port < ports; port++)
+		{
+			float sample = bus[port][i] * 32767.0f;
+
+			if (sample > 32767.0f) sample = 32767.0f;
+			if (sample < -32768.0f) sample = -32768.0f;
+
+			output[i * ports + port] = (int16_t)sample;
+		}
+	}
+}
+
+// Products are summed into eight partial sums, one per tap modulo eight, which are
+// then added pairwise. That is how an eight wide register accumulates; four wide
+// sets get the same order from two registers.
+static void convolveScalar(float* output, const float* src, const unsigned int* offsets, const float* const* phases, const float* fractions, unsigned int taps, unsigned int frames)
+{
+	for (unsigned int i = 0; i < frames; i++)
+	{
+		const float* samples = src + offsets[i];
+		const float* row = phases[i];
+		const float* nextRow = phases[i] + taps;
+		float fraction = fractions[i];
+		float sums[8] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+
+		for (unsigned int k = 0; k < taps; k++)
+		{
+			float coefficient = row[k] + (nextRow[k] - row[k]) * fraction;
+			sums[k & 7] += samples[k] * coefficient;
+		}
+
+		float quad[4];
+		for (int j = 0; j < 4; j++)
+		{
+			quad[j] = sums[j] + sums[j + 4];
+		}
+
+		output[i] = (quad[0] + quad[2]) + (quad[1] + quad[3]);
+	}
+}
+
+static void applyRampScalar(float* samples, float gain, float step, unsigned int first, unsigned int frames)
+{
+	for (unsigned int i = first; i < frames; i++)
+	{
+		samples[i] *= gain + step * (float)i;
+	}
+}
+
+// Transposed direct form II like tsf_voice_lowpass_process, in float. The coefficients
+// are stepped towards the next block's every frame.
+static void lowpassScalar(float* samples, float* state, const float* coefficients, unsigned int frames)
+{
+	const unsigned int lanes = MIXER_FILTER_LANES;
+
+	for (unsigned int lane = 0; lane < lanes; lane++)
+	{
+		float z1 = state[lane];
+		float z2 = state[lanes + lane];
+		float a0 = coefficients[lane];
+		float b1 = coefficients[lanes + lane];
+		float b2 = coefficients[lanes * 2 + lane];
+
+		for (unsigned int i = 0; i < frames; i++)
+		{
+			float in = samples[i * lanes + lane];
+			float out = in * a0 + z1;
+
+			z1 = in * (a0 + a0) + z2 - b1 * out;
+			z2 = in * a0 - b2 * out;
+			samples[i * lanes + lane] = out;
+
+			a0 += coefficients[lanes * 3 + lane];
+			b1 += coefficients[lanes * 4 + lane];
+			b2 += coefficients[lanes * 5 + lane];
+		}
+
+		state[lane] = z1;
+		state[lanes + lane] = z2;
+	}
+}
+
+// Adds up the eight lanes in the order the vector sets do, halves first
+static inline float laneSum(const float* lanes)
+{
+	return ((lanes[0] + lanes[4]) + (lanes[2] + lanes[6])) + ((lanes[1] + lanes[5]) + (lanes[3] + lanes[7]));
+}
+
+static void reverbLinesScalar(float* lines, float* state, const float* coefficients, const float* input, float* left, float* right, unsigned int frames)
+{
+	const unsigned int lanes = MIXER_FILTER_LANES;
+
+	for (unsigned int i = 0; i < frames; i++)
+	{
+		float* frame = lines + i * lanes;
+		float outLeft[lanes], outRight[lanes], damped[lanes];
+
+		for (unsigned int lane = 0; lane < lanes; lane++)
+		{
+			outLeft[lane] = frame[lane] * coefficients[lanes * 3 + lane];
+			outRight[lane] = frame[lane] * coefficients[lanes * 4 + lane];
+			damped[lane] = frame[lane] * coefficients[lanes + lane] + state[lane] * coefficients[lane];
+			state[lane] = damped[lane];
+		}
+
+		left[i] = laneSum(outLeft);
+		right[i] = laneSum(outRight);
+
+		float reflected = laneSum(damped) * (2.0f / lanes);
+
+		for (unsigned int lane = 0; lane < lanes; lane++)
+		{
+			frame[lane] = (damped[lane] - reflected) + input[i] * coefficients[lanes * 2 + lane];
+		}
+	}
+}
+
+static void mixU8Scalar(float* const* bus, unsigned int ports, const uint8_t* src, unsigned int channels, const float* gains, unsigned int frames)
+{
+	mixPcmScalar(bus, ports, src, channels, gains, 0, frames);
+}
+
+static void mixS16Scalar(float* const* bus, unsigned int ports, const int16_t* src, unsigned int channels, const float* gains, unsigned int frames)
+{
+	mixPcmScalar(bus, ports, src, channels, gains, 0, frames);
+}
+
+static void mixF32ScalarAll(float* const* bus, unsigned int ports, const float* src, const float* gains, unsigned int frames)
+{
+	mixF32Scalar(bus, ports, src, gains, 0, frames);
+}
+
+static void outputS16ScalarAll(int16_t* output, const float* const* bus, unsigned int ports, unsigned int frames)
+{
+	outputS16Scalar(output, bus, ports, 0, frames);
+}
+
+static void applyRampScalarAll(float* samples, float gain, float step, unsigned int frames)
+{
+	applyRampScalar(samples, gain, step, 0, frames);
+}
+
+static const MixerKernels g_scalarKernels =
+{
+	"scalar", mixU8Scalar, mixS16Scalar, mixF32ScalarAll, outputS16ScalarAll, convolveScalar, applyRampScalarAll, lowpassScalar, reverbLinesScalar
+};
+
+#ifdef MIXER_X86
+
+// SSE2, four frames per step. Mono and stereo sources are vectorized, anything
+// wider and the tail of each block go through the scalar loop.
+
+MIXER_TARGET("sse2")
+static inline void accumulateSse2(float* const* bus, unsigned int ports, const float* gains, unsigned int i, __m128 sample)
+{
+	for (unsigned int port = 0; port < ports; port++)
+	{
+		__m128 mixed = _mm_loadu_ps(bus[port] + i);
+		mixed = _mm_add_ps(mixed, _mm_mul_ps(sample, _mm_set1_ps(gains[port])));
+		_mm_storeu_ps(bus[port] + i, mixed);
+	}
+}
+
+MIXER_TARGET("sse2")
+static void mixU8Sse2(float* const* bus, unsigned int ports, const uint8_t* src, unsigned int channels, const float* gains, unsigned int frames)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i bias = _mm_set1_epi32(128);
+	const __m128 scale = _mm_set1_ps(1.0f / 128.0f);
+	unsigned int i = 0;
+
+	if (channels == 1)
+	{
+		for (; i + 8 <= frames; i += 8)
+		{
+			__m128i words = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(src + i)), zero);
+			__m128i lo = _mm_sub_epi32(_mm_unpacklo_epi16(words, zero), bias);
+			__m128i hi = _mm_sub_epi32(_mm_unpackhi_epi16(words, zero), bias);
+
+			accumulateSse2(bus, ports, gains, i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+			accumulateSse2(bus, ports, gains, i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+		}
+	}
+	else if (channels == 2)
+	{
+		const __m128i lowWord = _mm_set1_epi32(0xFFFF);
+
+		for (; i + 4 <= frames; i += 4)
+		{
+			__m128i words = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(src + i * 2)), zero);
+			__m128i left = _mm_sub_epi32(_mm_and_si128(words, lowWord), bias);
+			__m128i right = _mm_sub_epi32(_mm_srli_epi32(words, 16), bias);
+
+			accumulateSse2(bus, ports, gains, i, _mm_mul_ps(_mm_cvtepi32_ps(left), scale));
+			accumulateSse2(bus, ports, gains + ports, i, _mm_mul_ps(_mm_cvtepi32_ps(right), scale));
+		}
+	}
+
+	mixPcmScalar(bus, ports, src, channels, gains, i, frames);
+}
+
+MIXER_TARGET("sse2")
+static void mixS16Sse2(float* const* bus, unsigned int ports, const int16_t* src, unsigned int channels, const float* gains, unsigned int frames)
+{
+	const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+	unsigned int i = 0;
+
+	if (channels == 1)
+	{
+		for (; i + 8 <= frames; i += 8)
+		{
+			__m128i words = _mm_loadu_si128((const __m128i*)(src + i));
+			__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(words, words), 16);
+			__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(words, words), 16);
+
+			accumulateSse2(bus, ports, gains, i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+			accumulateSse2(bus, ports, gains, i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+		}
+	}
+	else if (channels == 2)
+	{
+		for (; i + 4 <= frames; i += 4)
+		{
+			__m128i words = _mm_loadu_si128((const __m128i*)(src + i * 2));
+			__m128i left = _mm_srai_epi32(_mm_slli_epi32(words, 16), 16);
+			__m128i right = _mm_srai_epi32(words, 16);
+
+			accumulateSse2(bus, ports, gains, i, _mm_mul_ps(_mm_cvtepi32_ps(left), scale));
+			accumulateSse2(bus, ports, gains + ports, i, _mm_mul_ps(_mm_cvtepi32_ps(right), scale));
+		}
+	}
+
+	mixPcmScalar(bus, ports, src, channels, gains, i, frames);
+}
+
+MIXER_TARGET("sse2")
+static void mixF32Sse2(float* const* bus, unsigned int ports, const float* src, const float* gains, unsigned int frames)
+{
+	unsigned int i = 0;
+
+	for (; i + 4 <= frames; i += 4)
+	{
+		accumulateSse2(bus, ports, gains, i, _mm_loadu_ps(src + i));
+	}
+
+	mixF32Scalar(bus, ports, src, gains, i, frames);
+}
+
+MIXER_TARGET("sse2")
+static void outputS16Sse2(int16_t* output, const float* const* bus, unsigned int ports, unsigned int frames)
+{
+	unsigned int i = 0;
+
+	if (ports == 2)
+	{
+		const __m128 scale = _mm_set1_ps(32767.0f);
+		const __m128 high = _mm_set1_ps(32767.0f);
+		const __m128 low = _mm_set1_ps(-32768.0f);
+
+		for (; i + 4 <= frames; i += 4)
+		{
+			__m128 left = _mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(bus[0] + i), scale), high), low);
+			__m128 right = _mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(bus[1] + i), scale), high), low);
+			__m128i l = _mm_cvttps_epi32(left);
+			__m128i r = _mm_cvttps_epi32(right);
+
+			__m128i packed = _mm_packs_epi32(_mm_unpacklo_epi32(l, r), _mm_unpackhi_epi32(l, r));
+			_mm_storeu_si128((__m128i*)(output + i * 2), packed);
+		}
+	}
+	else if (ports == 4)
+	{
+		const __m128 scale = _mm_set1_ps(32767.0f);
+		const __m128 high = _mm_set1_ps(32767.0f);
+		const __m128 low = _mm_set1_ps(-32768.0f);
+
+		for (; i + 4 <= frames; i += 4)
+		{
+			__m128 rows[4];
+			for (int port = 0; port < 4; port++)
+			{
+				rows[port] = _mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(bus[port] + i), scale), high), low);
+			}
+
+			// Each row becomes one frame of four channels
+			_MM_TRANSPOSE4_PS(rows[0], rows[1], rows[2], rows[3]);
+
+			_mm_storeu_si128((__m128i*)(output + i * 4), _mm_packs_epi32(_mm_cvttps_epi32(rows[0]), _mm_cvttps_epi32(rows[1])));
+			_mm_storeu_si128((__m128i*)(output + i * 4 + 8), _mm_packs_epi32(_mm_cvttps_epi32(rows[2]), _mm_cvttps_epi32(rows[3])));
+		}
+	}
+
+	outputS16Scalar(output, bus, ports, i, frames);
+}
+
+// Adds up the four lanes as (0 + 2) + (1 + 3)
+MIXER_TARGET("sse2")
+static inline float horizontalSumSse2(__m128 sum)
+{
+	__m128 pairs = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+	return _mm_cvtss_f32(_mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, 1)));
+}
+
+MIXER_TARGET("sse2")
+static void convolveSse2(float* output, const float* src, const unsigned int* offsets, const float* const* phases, const float* fractions, unsigned int taps, unsigned int frames)
+{
+	for (unsigned int i = 0; i < frames; i++)
+	{
+		const float* samples = src + offsets[i];
+		const float* row = phases[i];
+		const float* nextRow = phases[i] + taps;
+		__m128 fraction = _mm_set1_ps(fractions[i]);
+		__m128 low = _mm_setzero_ps();
+		__m128 high = _mm_setzero_ps();
+
+		for (unsigned int k = 0; k < taps; k += 8)
+		{
+			__m128 r0 = _mm_loadu_ps(row + k);
+			__m128 r1 = _mm_loadu_ps(row + k + 4);
+			__m128 c0 = _mm_add_ps(r0, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(nextRow + k), r0), fraction));
+			__m128 c1 = _mm_add_ps(r1, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(nextRow + k + 4), r1), fraction));
+
+			low = _mm_add_ps(low, _mm_mul_ps(_mm_loadu_ps(samples + k), c0));
+			high = _mm_add_ps(high, _mm_mul_ps(_mm_loadu_ps(samples + k + 4), c1));
+		}
+
+		output[i] = horizontalSumSse2(_mm_add_ps(low, high));
+	}
+}
+
+// Frame indices count up in a float register, exact for any frame count a period has
+MIXER_TARGET("sse2")
+static void applyRampSse2(float* samples, float gain, float step, unsigned int frames)
+{
+	__m128 index = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+	const __m128 four = _mm_set1_ps(4.0f);
+	const __m128 start = _mm_set1_ps(gain);
+	const __m128 slope = _mm_set1_ps(step);
+	unsigned int i = 0;
+
+	for (; i + 4 <= frames; i += 4)
+	{
+		__m128 ramp = _mm_add_ps(start, _mm_mul_ps(slope, index));
+		_mm_storeu_ps(samples + i, _mm_mul_ps(_mm_loadu_ps(samples + i), ramp));
+		index = _mm_add_ps(index, four);
+	}
+
+	applyRampScalar(samples, gain, step, i, frames);
+}
+
+// The eight lanes as two vectors of four
+MIXER_TARGET("sse2")
+static void lowpassSse2(float* samples, float* state, const float* coefficients, unsigned int frames)
+{
+	__m128 z1[2], z2[2], a0[2], b1[2], b2[2], da0[2], db1[2], db2[2];
+
+	for (int h = 0; h < 2; h++)
+	{
+		z1[h] = _mm_loadu_ps(state + h * 4);
+		z2[h] = _mm_loadu_ps(state + MIXER_FILTER_LANES + h * 4);
+		a0[h] = _mm_loadu_ps(coefficients + h * 4);
+		b1[h] = _mm_loadu_ps(coefficients + MIXER_FILTER_LANES + h * 4);
+		b2[h] = _mm_loadu_ps(coefficients + MIXER_FILTER_LANES * 2 + h * 4);
+		da0[h] = _mm_loadu_ps(coefficients + MIXER_FILTER_LANES * 3 + h * 4);
+		db1[h] = _mm_loadu_ps(coefficients + MIXER_FILTER_LANES * 4 + h * 4);
+		db2[h] = _mm_loadu_ps(coefficients + MIXER_FILTER_LANES * 5 + h * 4);
+	}
+
+	for (unsigned int i = 0; i < frames; i++)
+	{
+		for (int h = 0; h < 2; h++)
+		{
+			float* frame = samples + i * MIXER_FILTER_LANES + h * 4;
+			__m128 in = _mm_loadu_ps(frame);
+			__m128 out = _mm_add_ps(_mm_mul_ps(in, a0[h]), z1[h]);
+
+			z1[h] = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(in, _mm_add_ps(a0[h], a0[h])), z2[h]), _mm_mul_ps(b1[h], out));
+			z2[h] = _mm_sub_ps(_mm_mul_ps(in, a0[h]), _mm_mul_ps(b2[h], out));
+			_mm_storeu_ps(frame, out);
+
+			a0[h] = _mm_add_ps(a0[h], da0[h]);
+			b1[h] = _mm_add_ps(b1[h], db1[h]);
+			b2[h] = _mm_add_ps(b2[h], db2[h]);
+		}
+	}
+
+	for (int h = 0; h < 2; h++)
+	{
+		_mm_storeu_ps(state + h * 4, z1[h]);
+		_mm_storeu_ps(state + MIXER_FILTER_LANES + h * 4, z2[h]);
+	}
+}
+
+// The eight lanes as two vectors of four, summed across with both halves added first
+MIXER_TARGET("sse2")
+static void reverbLinesSse2(float* lines, float* state, const float* coefficients, const float* input, float* left, float* right, unsigned int frames)
+{
+	__m128 damped[2], pole[2], gain[2], inGain[2], leftGain[2], rightGain[2];
+	const __m128 scale = _mm_set1_ps(2.0f / MIXER_FILTER_LANES);
+
+	for (int h = 0; h < 2; h++)
+	{
+		damped[h] = _mm_loadu_ps(state + h * 4);
+		pole[h] = _mm_loadu_ps(coefficients + h * 4);
+		gain[h] = _mm_loadu_ps(coefficients + MIXER_FILTER_LANES + h * 4);
+		inGain[h] = _mm_loadu_ps(coefficients + MIXER_FILTER_LANES * 2 + h * 4);
+		leftGain[h] = _mm_loadu_ps(coefficients + MIXER_FILTER_LANES * 3 + h * 4);
+		rightGain[h] = _mm_loadu_ps(coefficients + MIXER_FILTER_LANES * 4 + h * 4);
+	}
+
+	for (unsigned int i = 0; i < frames; i++)
+	{
+		float* frame = lines + i * MIXER_FILTER_LANES;
+		__m128 out[2];
+
+		for (int h = 0; h < 2; h++)
+		{
+			out[h] = _mm_loadu_ps(frame + h * 4);
+			damped[h] = _mm_add_ps(_mm_mul_ps(out[h], gain[h]), _mm_mul_ps(damped[h], pole[h]));
+		}
+
+		left[i] = horizontalSumSse2(_mm_add_ps(_mm_mul_ps(out[0], leftGain[0]), _mm_mul_ps(out[1], leftGain[1])));
+		right[i] = horizontalSumSse2(_mm_add_ps(_mm_mul_ps(out[0], rightGain[0]), _mm_mul_ps(out[1], rightGain[1])));
+
+		__m128 reflected = _mm_mul_ps(_mm_set1_ps(horizontalSumSse2(_mm_add_ps(damped[0], damped[1]))), scale);
+		__m128 in = _mm_set1_ps(input[i]);
+
+		for (int h = 0; h < 2; h++)
+		{
+			_mm_storeu_ps(frame + h * 4, _mm_add_ps(_mm_sub_ps(damped[h], reflected), _mm_mul_ps(in, inGain[h])));
+		}
+	}
+
+	for (int h = 0; h < 2; h++)
+	{
+		_mm_storeu_ps(state + h * 4, damped[h]);
+	}
+}
+
+static const MixerKernels g_sse2Kernels =
+{
+	"sse2", mixU8Sse2, mixS16Sse2, mixF32Sse2, outputS16Sse2, convolveSse2, applyRampSse2, lowpassSse2, reverbLinesSse2
+};
+
+// AVX2, eight frames per step.
+
+MIXER_TARGET("avx2")
+static inline void accumulateAvx2(float* const* bus, unsigned int ports, const float* gains, unsigned int i, __m256 sample)
+{
+	for (unsigned int port = 0; port < ports; port++)
+	{
+		__m256 mixed = _mm256_loadu_ps(bus[port] + i);
+		mixed = _mm256_add_ps(mixed, _mm256_mul_ps(sample, _mm256_set1_ps(gains[port])));
+		_mm256_storeu_ps(bus[port] + i, mixed);
+	}
+}
+
+MIXER_TARGET("avx2")
+static void mixU8Avx2(float* const* bus, unsigned int ports, const uint8_t* src, unsigned int channels, const float* gains, unsigned int frames)
+{
+	const __m256i bias = _mm256_set1_epi32(128);
+	const __m256 scale = _mm256_set1_ps(1.0f / 128.0f);
+	unsigned int i = 0;
+
+	if (channels == 1)
+	{
+		for (; i + 8 <= frames; i += 8)
+		{
+			__m256i samples = _mm256_sub_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src + i))), bias);
+
+			accumulateAvx2(bus, ports, gains, i, _mm256_mul_ps(_mm256_cvtepi32_ps(samples), scale));
+		}
+	}
+	else if (channels == 2)
+	{
+		const __m256i lowWord = _mm256_set1_epi32(0xFFFF);
+
+		for (; i + 8 <= frames; i += 8)
+		{
+			__m256i words = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(src + i * 2)));
+			__m256i left = _mm256_sub_epi32(_mm256_and_si256(words, lowWord), bias);
+			__m256i right = _mm256_sub_epi32(_mm256_srli_epi32(words, 16), bias);
+
+			accumulateAvx2(bus, ports, gains, i, _mm256_mul_ps(_mm256_cvtepi32_ps(left), scale));
+			accumulateAvx2(bus, ports, gains + ports, i, _mm256_mul_ps(_mm256_cvtepi32_ps(right), scale));
+		}
+	}
+
+	mixPcmScalar(bus, ports, src, channels, gains, i, frames);
+}
+
+MIXER_TARGET("avx2")
+static void mixS16Avx2(float* const* bus, unsigned int ports, const int16_t* src, unsigned int channels, const float* gains, unsigned int frames)
+{
+	const __m256 scale = _mm256_set1_ps(1.0f / 32768.0f);
+	unsigned int i = 0;
+
+	if (channels == 1)
+	{
+		for (; i + 8 <= frames; i += 8)
+		{
+			__m256i samples = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(src + i)));
+
+			accumulateAvx2(bus, ports, gains, i, _mm256_mul_ps(_mm256_cvtepi32_ps(samples), scale));
+		}
+	}
+	else if (channels == 2)
+	{
+		for (; i + 8 <= frames; i += 8)
+		{
+			__m256i words = _mm256_loadu_si256((const __m256i*)(src + i * 2));
+			__m256i left = _mm256_srai_epi32(_mm256_slli_epi32(words, 16), 16);
+			__m256i right = _mm256_srai_epi32(words, 16);
+
+			accumulateAvx2(bus, ports, gains, i, _mm256_mul_ps(_mm256_cvtepi32_ps(left), scale));
+			accumulateAvx2(bus, ports, gains + ports, i, _mm256_mul_ps(_mm256_cvtepi32_ps(right), scale));
+		}
+	}
+
+	mixPcmScalar(bus, ports, src, channels, gains, i, frames);
+}
+
+MIXER_TARGET("avx2")
+static void mixF32Avx2(float* const* bus, unsigned int ports, const float* src, const float* gains, unsigned int frames)
+{
+	unsigned int i = 0;
+
+	for (; i + 8 <= frames; i += 8)
+	{
+		accumulateAvx2(bus, ports, gains, i, _mm256_loadu_ps(src + i));
+	}
+
+	mixF32Scalar(bus, ports, src, gains, i, frames);
+}
+
+MIXER_TARGET("avx2")
+static void outputS16Avx2(int16_t* output, const float* const* bus, unsigned int ports, unsigned int frames)
+{
+	unsigned int i = 0;
+
+	if (ports != 2)
+	{
+		outputS16Sse2(output, bus, ports, frames);
+		return;
+	}
+
+	const __m256 scale = _mm256_set1_ps(32767.0f);
+	const __m256 high = _mm256_set1_ps(32767.0f);
+	const __m256 low = _mm256_set1_ps(-32768.0f);
+
+	for (; i + 8 <= frames; i += 8)
+	{
+		__m256 left = _mm256_max_ps(_mm256_min_ps(_mm256_mul_ps(_mm256_loadu_ps(bus[0] + i), scale), high), low);
+		__m256 right = _mm256_max_ps(_mm256_min_ps(_mm256_mul_ps(_mm256_loadu_ps(bus[1] + i), scale), high), low);
+		__m256i l = _mm256_cvttps_epi32(left);
+		__m256i r = _mm256_cvttps_epi32(right);
+
+		// Unpack and pack both work within 128-bit lanes, which keeps the frames in order
+		__m256i packed = _mm256_packs_epi32(_mm256_unpacklo_epi32(l, r), _mm256_unpackhi_epi32(l, r));
+		_mm256_storeu_si256((__m256i*)(output + i * 2), packed);
+	}
+
+	outputS16Scalar(output, bus, ports, i, frames);
+}
+
+MIXER_TARGET("avx2")
+static void convolveAvx2(float* output, const float* src, const unsigned int* offsets, const float* const* phases, const float* fractions, unsigned int taps, unsigned int frames)
+{
+	for (unsigned int i = 0; i < frames; i++)
+	{
+		const float* samples = src + offsets[i];
+		const float* row = phases[i];
+		const float* nextRow = phases[i] + taps;
+		__m256 fraction = _mm256_set1_ps(fractions[i]);
+		__m256 sum = _mm256_setzero_ps();
+
+		for (unsigned int k = 0; k < taps; k += 8)
+		{
+			__m256 r = _mm256_loadu_ps(row + k);
+			__m256 coefficients = _mm256_add_ps(r, _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(nextRow + k), r), fraction));
+			sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(samples + k), coefficients));
+		}
+
+		output[i] = horizontalSumSse2(_mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1)));
+	}
+}
+
+MIXER_TARGET("avx2")
+static void applyRampAvx2(float* samples, float gain, float step, unsigned int frames)
+{
+	__m256 index = _mm256_set_ps(7.0f, 6.0f, 5.0f, 4.0f, 3.0f, 2.0f, 1.0f, 0.0f);
+	const __m256 eight = _mm256_set1_ps(8.0f);
+	const __m256 start = _mm256_set1_ps(gain);
+	const __m256 slope = _mm256_set1_ps(step);
+	unsigned int i = 0;
+
+	for (; i + 8 <= frames; i += 8)
+	{
+		__m256 ramp = _mm256_add_ps(start, _mm256_mul_ps(slope, index));
+		_mm256_storeu_ps(samples + i, _mm256_mul_ps(_mm256_loadu_ps(samples + i), ramp));
+		index = _mm256_add_ps(index, eight);
+	}
+
+	applyRampScalar(samples, gain, step, i, frames);
+}
+
+MIXER_TARGET("avx2")
+static void lowpassAvx2(float* samples, float* state, const float* coefficients, unsigned int frames)
+{
+	__m256 z1 = _mm256_loadu_ps(state);
+	__m256 z2 = _mm256_loadu_ps(state + MIXER_FILTER_LANES);
+	__m256 a0 = _mm256_loadu_ps(coefficients);
+	__m256 b1 = _mm256_loadu_ps(coefficients + MIXER_FILTER_LANES);
+	__m256 b2 = _mm256_loadu_ps(coefficients + MIXER_FILTER_LANES * 2);
+	const __m256 da0 = _mm256_loadu_ps(coefficients + MIXER_FILTER_LANES * 3);
+	const __m256 db1 = _mm256_loadu_ps(coefficients + MIXER_FILTER_LANES * 4);
+	const __m256 db2 = _mm256_loadu_ps(coefficients + MIXER_FILTER_LANES * 5);
+
+	for (unsigned int i = 0; i < frames; i++)
+	{
+		float* frame = samples + i * MIXER_FILTER_LANES;
+		__m256 in = _mm256_loadu_ps(frame);
+		__m256 out = _mm256_add_ps(_mm256_mul_ps(in, a0), z1);
+
+		z1 = _mm256_sub_ps(_mm256_add_ps(_mm256_mul_ps(in, _mm256_add_ps(a0, a0)), z2), _mm256_mul_ps(b1, out));
+		z2 = _mm256_sub_ps(_mm256_mul_ps(in, a0), _mm256_mul_ps(b2, out));
+		_mm256_storeu_ps(frame, out);
+
+		a0 = _mm256_add_ps(a0, da0);
+		b1 = _mm256_add_ps(b1, db1);
+		b2 = _mm256_add_ps(b2, db2);
+	}
+
+	_mm256_storeu_ps(state, z1);
+	_mm256_storeu_ps(state + MIXER_FILTER_LANES, z2);
+}
+
+// Adds up the eight lanes as the low and high half first, then like horizontalSumSse2
+MIXER_TARGET("avx2")
+static inline float horizontalSumAvx2(__m256 sum)
+{
+	__m128 quad = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+	__m128 pairs = _mm_add_ps(quad, _mm_movehl_ps(quad, quad));
+	return _mm_cvtss_f32(_mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, 1)));
+}
+
+MIXER_TARGET("avx2")
+static void reverbLinesAvx2(float* lines, float* state, const float* coefficients, const float* input, float* left, float* right, unsigned int frames)
+{
+	__m256 damped = _mm256_loadu_ps(state);
+	const __m256 pole = _mm256_loadu_ps(coefficients);
+	const __m256 gain = _mm256_loadu_ps(coefficients + MIXER_FILTER_LANES);
+	const __m256 inGain = _mm256_loadu_ps(coefficients + MIXER_FILTER_LANES * 2);
+	const __m256 leftGain = _mm256_loadu_ps(coefficients + MIXER_FILTER_LANES * 3);
+	const __m256 rightGain = _mm256_loadu_ps(coefficients + MIXER_FILTER_LANES * 4);
+	const __m256 scale = _mm256_set1_ps(2.0f / MIXER_FILTER_LANES);
+
+	for (unsigned int i = 0; i < frames; i++)
+	{
+		float* frame = lines + i * MIXER_FILTER_LANES;
+		__m256 out = _mm256_loadu_ps(frame);
+
+		damped = _mm256_add_ps(_mm256_mul_ps(out, gain), _mm256_mul_ps(damped, pole));
+		left[i] = horizontalSumAvx2(_mm256_mul_ps(out, leftGain));
+		right[i] = horizontalSumAvx2(_mm256_mul_ps(out, rightGain));
+
+		__m256 reflected = _mm256_mul_ps(_mm256_set1_ps(horizontalSumAvx2(damped)), scale);
+		_mm256_storeu_ps(frame, _mm256_add_ps(_mm256_sub_ps(damped, reflected), _mm256_mul_ps(_mm256_set1_ps(input[i]), inGain)));
+	}
+
+	_mm256_storeu_ps(state, damped);
+}
+
+static const MixerKernels g_avx2Kernels =
+{
+	"avx2", mixU8Avx2, mixS16Avx2, mixF32Avx2, outputS16Avx2, convolveAvx2, applyRampAvx2, lowpassAvx2, reverbLinesAvx2
+};
+
+static bool cpuHasSse2()
+{
+#if defined(_M_X64) || defined(__x86_64__)
+	return true;
+#elif defined(_MSC_VER)
+	int regs[4];
+	__cpuid(regs, 1);
+	return (regs[3] & (1 << 26)) != 0;
+#else
+	return __builtin_cpu_supports("sse2");
+#endif
+}
+
+static bool cpuHasAvx2()
+{
+#ifdef _MSC_VER
+	int regs[4];
+	__cpuid(regs, 0);
+	if (regs[0] < 7)
+		return false;
+
+	// AVX needs OS support for saving the upper register halves too
+	__cpuid(regs, 1);
+	if ((regs[2] & (1 << 27)) == 0 || (regs[2] & (1 << 28)) == 0)
+		return false;
+	if ((_xgetbv(0) & 6) != 6)
+		return false;
+
+	__cpuidex(regs, 7, 0);
+	return (regs[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
+
+const MixerKernels* mixerSelectKernels()
+{
+	const MixerKernels* best = &g_scalarKernels;
+
+#ifdef MIXER_X86
+	if (cpuHasSse2())
+		best = &g_sse2Kernels;
+	if (cpuHasAvx2())
+		best = &g_avx2Kernels;
+#endif
+
+	const char* requested = getenv("OPENSEGAAPI_SIMD");
+	if (requested == nullptr)
+		return best;
+
+	if (strcmp(requested, "scalar") == 0)
+		return &g_scalarKernels;
+
+#ifdef MIXER_X86
+	if (strcmp(requested, "sse2") == 0 && cpuHasSse2())
+		return &g_sse2Kernels;
+	if (strcmp(requested, "avx2") == 0 && cpuHasAvx2())
+		return &g_avx2Kernels;
+#endif
+
+	info("mixerSelectKernels: %s is not available, using %s", requested, best->name);
+	return best;
+}
+
+// Scalar first, so every other set can be checked against it
+const MixerKernels* mixerKernelSet(unsigned int index)
+{
+	const MixerKernels* sets[] = {
+		&g_scalarKernels,
+#ifdef MIXER_X86
+		cpuHasSse2() ? &g_sse2Kernels : nullptr,
+		cpuHasAvx2() ? &g_avx2Kernels : nullptr,
+#endif
+	};
+
+	for (const MixerKernels* kernels : sets)
+	{
+		if (kernels != nullptr && index-- == 0)
+			return kernels;
+	}
+
+	return nullptr;
+}
@@ -0,0 +1,57 @@
+/*
+* This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+*
+* See LICENSE and MENTIONS in the root of the source tree for information
+* regarding licensing.
+*/
+#pragma once
+
+#include <stdint.h>
+
+// Channels the voice low-pass filters side by side, one per vector lane
+#define MIXER_FILTER_LANES 8
+
+// Inner loops of the mixer. The bus is planar, one float array per output port, and
+// gains for interleaved sources are laid out as gains[channel * ports + port].
+struct MixerKernels
+{
+	const char* name;
+
+	// Converts interleaved PCM to float, scales each channel by its per-port gains
+	// and accumulates into the bus in a single pass.
+	void(*mixU8)(float* const* bus, unsigned int ports, const uint8_t* src, unsigned int channels, const float* gains, unsigned int frames);
+	void(*mixS16)(float* const* bus, unsigned int ports, const int16_t* src, unsigned int channels, const float* gains, unsigned int frames);
+
+	// Accumulates one already converted channel, gains[port]
+	void(*mixF32)(float* const* bus, unsigned int ports, const float* src, const float* gains, unsigned int frames);
+
+	// Clamps the bus to 16 bits and interleaves it into the output
+	void(*outputS16)(int16_t* output, const float* const* bus, unsigned int ports, unsigned int frames);
+
+	// Polyphase filter: output frame i is the taps source samples from src + offsets[i]
+	// weighted by a row interpolated fractions[i] of the way from phases[i] to the row
+	// after it. Taps is a multiple of eight.
+	void(*convolve)(float* output, const float* src, const unsigned int* offsets, const float* const* phases, const float* fractions, unsigned int taps, unsigned int frames);
+
+	// Scales one channel by a linear ramp, frame i by gain + step * i
+	void(*applyRamp)(float* samples, float gain, float step, unsigned int frames);
+
+	// Low-pass biquads on MIXER_FILTER_LANES channels at once, filtered in place. Samples
+	// are interleaved, a frame of every lane after the other. State is z1 of every lane,
+	// then z2. Coefficients are a0, b1 and b2 of every lane, then what each of them
+	// changes by per frame.
+	void(*lowpass)(float* samples, float* state, const float* coefficients, unsigned int frames);
+
+	// Feedback delay network of the reverb, a delay line per lane. Lines holds what each
+	// line puts out, interleaved like the low-pass, and on return what goes back into it:
+	// damped by a one-pole, mixed with the others through a Householder matrix and added
+	// to the input. Coefficients are the pole, the gain before it, the input gain and the
+	// left and right output gains of every lane. State is the one-pole of every lane.
+	void(*reverbLines)(float* lines, float* state, const float* coefficients, const float* input, float* left, float* right, unsigned int frames);
+};
+
+// The widest set this CPU supports, or the one named by OPENSEGAAPI_SIMD (scalar, sse2, avx2).
+const MixerKernels* mixerSelectKernels();
+
+// The sets this CPU supports, scalar at 0, then from the narrowest up. Null past the last.
+const MixerKernels* mixerKernelSet(unsigned int index);
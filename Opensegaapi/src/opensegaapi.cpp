@@ -4,21 +4,28 @@
 * See LICENSE and MENTIONS in the root of the source tree for information
 * regarding licensing.
 */
-extern "C" {
-#include "opensegaapi.h"
-}
+#ifdef _WIN32
+// The GUIDs in opensegaapi.h are defined here, everywhere else only declared
+#include "platform.h"
+#include <initguid.h>
+#endif
+
+#include "buffer.h"
+#include "mixer.h"
+#include "backend.h"
+#include "callbacks.h"
+#include "handle_table.h"
+#include "pool.h"
+#include "log.h"
 
 #include <vector>
-#include <dsound.h>
+#include <mutex>
 #include <algorithm>
-#define CHECK_HR(exp) { HRESULT hr = exp; if (FAILED(hr)) { printf("failed %s: %08x\n", #exp, hr); abort(); } }
-#pragma comment(lib, "dsound.lib")
-#pragma comment(lib, "dxguid.lib")
-
-#include <concurrent_queue.h>
-#include <functional>
-
-struct OPEN_segaapiBuffer_t;
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #ifdef _DEBUG
 void info(const char* format, ...)
@@ -30,135 +37,36 @@ void info(const char* format, ...)
 	int len = _vsnprintf_s(buffer, sizeof(buffer), format, args);
 	va_end(args);
 
+	if (len < 0 || len > (int)sizeof(buffer) - 2)
+		len = sizeof(buffer) - 2;
+
 	buffer[len] = '\n';
 	buffer[len + 1] = '\0';
 
 	OutputDebugStringA(buffer);
 }
-#else
-#define info(x, ...) {}
 #endif
 
-struct OPEN_segaapiBuffer_t
-{
-	void* userData;
-	OPEN_HAWOSEGABUFFERCALLBACK callback;
-	bool synthesizer;
-	bool loop;
-	unsigned int channels;
-	unsigned int startLoop;
-	unsigned int endLoop;
-	unsigned int endOffset;
-	unsigned int sampleRate;
-	unsigned int sampleFormat;
-	uint8_t* data;
-	size_t size;
-	bool playing;
-	bool paused;
-	bool playWithSetup;
-	bool ownsData;
-	bool pendingRouting;
-
-	WAVEFORMATEX dsFormat;
-
-	IDirectSoundBuffer* dsBuffer;
-	DWORD lastPlayCursor;
-
-	float sendVolumes[7];
-	int sendChannels[7];
-	OPEN_HAROUTING sendRoutes[7];
-	float channelVolumes[6];
-
-	concurrency::concurrent_queue<std::function<void()>> defers;
-
-	float masterVolume;
-	float frequency;
-	long pan;
-};
-
-static IDirectSound8* g_dsound;
-static float g_masterVolumes[12] = { 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f };
-static std::vector<OPEN_segaapiBuffer_t*> g_allBuffers;
+// Commands one API call hands to the mixer together. Most fit in commands; a setup
+// that outgrows it moves to large, so a batch always goes out in one push.
+#define MAX_BATCH_COMMANDS 64
 
-static void dumpWaveBuffer(const char* path, unsigned int channels, unsigned int sampleRate, unsigned int sampleBits, void* data, size_t size)
+struct CommandBatch
 {
-	info("dumpWaveBuffer path %s channels %d sampleRate %d sampleBits %d size %d", path, channels, sampleRate, sampleBits, size);
-
-	struct RIFF_Header
-	{
-		char chunkID[4];
-		long chunkSize;
-		char format[4];
-	};
-
-	struct WAVE_Format
-	{
-		char subChunkID[4];
-		long subChunkSize;
-		short audioFormat;
-		short numChannels;
-		long sampleRate;
-		long byteRate;
-		short blockAlign;
-		short bitsPerSample;
-	};
-
-	struct WAVE_Data
-	{
-		char subChunkID[4];
-		long subChunk2Size;
-	};
-
-	FILE* soundFile = NULL;
-	struct WAVE_Format wave_format;
-	struct RIFF_Header riff_header;
-	struct WAVE_Data wave_data;
-
-	soundFile = fopen(path, "wb");
-	if (soundFile == NULL)
-	{
-		info("dumpWaveBuffer: Failed to open file %s", path);
-		return;
-	}
-
-	riff_header.chunkID[0] = 'R';
-	riff_header.chunkID[1] = 'I';
-	riff_header.chunkID[2] = 'F';
-	riff_header.chunkID[3] = 'F';
-	riff_header.format[0] = 'W';
-	riff_header.format[1] = 'A';
-	riff_header.format[2] = 'V';
-	riff_header.format[3] = 'E';
-
-	fwrite(&riff_header, sizeof(struct RIFF_Header), 1, soundFile);
-
-	wave_format.subChunkID[0] = 'f';
-	wave_format.subChunkID[1] = 'm';
-	wave_format.subChunkID[2] = 't';
-	wave_format.subChunkID[3] = ' ';
-
-	wave_format.audioFormat = 1;
-	wave_format.sampleRate = sampleRate;
-	wave_format.numChannels = channels;
-	wave_format.bitsPerSample = sampleBits;
-	wave_format.byteRate = (sampleRate * sampleBits * channels) / 8;
-	wave_format.blockAlign = (sampleBits * channels) / 8;
-	wave_format.subChunkSize = 16;
-
-	fwrite(&wave_format, sizeof(struct WAVE_Format), 1, soundFile);
-
-	wave_data.subChunkID[0] = 'd';
-	wave_data.subChunkID[1] = 'a';
-	wave_data.subChunkID[2] = 't';
-	wave_data.subChunkID[3] = 'a';
-
-	wave_data.subChunk2Size = size;
-
-	fwrite(&wave_data, sizeof(struct WAVE_Data), 1, soundFile);
-	fwrite(data, wave_data.subChunk2Size, 1, soundFile);
+	MixerCommand commands[MAX_BATCH_COMMANDS];
+	std::vector<MixerCommand> large;
+	unsigned int count = 0;
+};
 
-	fclose(soundFile);
-}
+static OutputBackend* g_output;
+// Guards adding and removing buffers and the retired list, lookups need no lock
+static std::mutex g_buffersMutex;
+static HandleTable<OPEN_segaapiBuffer_t> g_buffers;
+// Destroyed, freed once the mixer has let go of them
+static std::vector<OPEN_segaapiBuffer_t*> g_retiredBuffers;
+// EAX properties of the FX slots as the game last set them, see SEGAAPI_SetGlobalEAXProperty
+static EAXFXSLOTPROPERTIES g_fxSlots[MIXER_FX_SLOTS];
+static EAXREVERBPROPERTIES g_fxReverbs[MIXER_FX_SLOTS];
 
 static void resetBuffer(OPEN_segaapiBuffer_t* buffer)
 {
@@ -197,574 +105,550 @@ static void resetBuffer(OPEN_segaapiBuffer_t* buffer)
 	buffer->sendChannels[6] = 0;
 	buffer->masterVolume = 1.0f;
 	buffer->frequency = 1.0f;
-	buffer->pan = 0;
+	buffer->notifyPointCount = 0;
+	buffer->notifyFrequency = 0;
 }
 
-static int getChannelToDuplicate(OPEN_segaapiBuffer_t* buffer)
+// Gives the mixer its copy of a new buffer. Done before the handle is returned, so
+// any command that reaches the mixer for it finds this in place.
+static void initVoice(OPEN_segaapiBuffer_t* buffer)
 {
-	// Only applies to stereo 16-bit PCM buffers
-	if (buffer->channels != 2 || buffer->sampleFormat != OPEN_HASF_SIGNED_16PCM)
-		return -1;
+	MixerVoice& voice = buffer->voice;
+
+	voice.handle = nullptr;
+	voice.callback = buffer->callback;
+	voice.data = buffer->data;
+	voice.channels = buffer->channels;
+	voice.sampleFormat = buffer->sampleFormat;
+	voice.blockAlign = buffer->format.nBlockAlign;
+	voice.totalFrames = (unsigned int)(buffer->size / buffer->format.nBlockAlign);
+	voice.synth = buffer->synthesizer;
+
+	voice.loop = buffer->loop;
+	voice.startLoop = buffer->startLoop;
+	voice.endLoop = buffer->endLoop;
+	voice.endOffset = buffer->endOffset;
+	voice.sampleRate = buffer->sampleRate;
+	voice.frequency = buffer->frequency;
 
-	// Detect if any channel is routed to BOTH left and right
-	for (int ch = 0; ch < (int)buffer->channels; ch++)
+	for (int i = 0; i < 7; i++)
 	{
-		bool toLeft = false;
-		bool toRight = false;
-
-		for (int i = 0; i < 7; i++)
-		{
-			if (buffer->sendRoutes[i] != OPEN_HA_UNUSED_PORT &&
-				buffer->sendVolumes[i] > 0.0f &&
-				buffer->sendChannels[i] == ch)
-			{
-				if (buffer->sendRoutes[i] == OPEN_HA_FRONT_LEFT_PORT ||
-					buffer->sendRoutes[i] == OPEN_HA_REAR_LEFT_PORT)
-					toLeft = true;
-				if (buffer->sendRoutes[i] == OPEN_HA_FRONT_RIGHT_PORT ||
-					buffer->sendRoutes[i] == OPEN_HA_REAR_RIGHT_PORT)
-					toRight = true;
-			}
-		}
+		voice.sendRoutes[i] = buffer->sendRoutes[i];
+		voice.sendChannels[i] = buffer->sendChannels[i];
+		voice.sendVolumes[i] = buffer->sendVolumes[i];
+	}
 
-		if (toLeft && toRight)
-		{
-			info("getChannelToDuplicate: Channel %d routed to BOTH L/R", ch);
-			return ch;
-		}
+	for (int i = 0; i < 6; i++)
+	{
+		voice.channelVolumes[i] = buffer->channelVolumes[i];
 	}
 
-	return -1; // No duplication needed
+	voice.masterVolume = buffer->masterVolume;
+	voice.priority = buffer->priority;
+	voice.notifyPointCount = 0;
+	voice.notifyInterval = 0;
+	voice.modEnvToPitch = 0.0f;
+	voice.modLfoToPitch = 0.0f;
+	voice.vibLfoToPitch = 0.0f;
+	voice.modLfoToAttenuation = 0.0f;
+
+	voice.cursor = 0;
+	voice.paused = false;
+	voice.positionSet = false;
+	voice.activeIndex = -1;
+	voice.playSerial = 0;
+	voice.wraps = 0;
+	voice.looped = false;
+	voice.notifyProgress = 0.0;
+	voice.pendingRouting = true;
+	voice.level = 0.0f;
+	voice.fxSlotCount = 0;
+	voice.routingGeneration = 0;
+	envelopeInit(&voice.volumeEnvelope, true);
+	envelopeInit(&voice.modEnvelope, false);
+	lfoInit(&voice.modLfo);
+	lfoInit(&voice.vibLfo);
+	voice.lfoGain = 1.0f;
+	voice.releasing = false;
+	voice.filterCutoff = MIXER_MAX_CUTOFF;
+	voice.filterQInv = 1.0f;
+	voice.modEnvToCutoff = 0.0f;
+	voice.modLfoToCutoff = 0.0f;
+	voice.filterCents = 0.0f;
+	memset(voice.filterState, 0, sizeof(voice.filterState));
+
+	voice.finishedSerial.store(0, std::memory_order_relaxed);
+	voice.position.store(0, std::memory_order_relaxed);
+	voice.retired.store(false, std::memory_order_relaxed);
 }
 
-// Helper function to duplicate a mono channel to stereo output
-static void duplicateChannelToStereo(void* dest, const void* src, size_t bytesToCopy, int sourceChannel)
+static void freeBuffer(OPEN_segaapiBuffer_t* buffer)
 {
-	int16_t* srcSamples = (int16_t*)src;
-	int16_t* dstSamples = (int16_t*)dest;
-	size_t numFrames = bytesToCopy / 4;  // 4 bytes per stereo 16-bit frame
-
-	info("duplicateChannelToStereo: Duplicating source channel %d to stereo output - %zu frames",
-		sourceChannel, numFrames);
-
-	for (size_t i = 0; i < numFrames; i++)
+	if (buffer->ownsData && buffer->data)
 	{
-		// Read the channel that needs duplication (0=left, 1=right)
-		int16_t sample = srcSamples[i * 2 + sourceChannel];
-
-		// Write to BOTH output channels
-		dstSamples[i * 2] = sample;      // Left output
-		dstSamples[i * 2 + 1] = sample;  // Right output
+		poolFreeSamples(buffer->data, buffer->size);
 	}
+
+	poolFreeBuffer(buffer);
 }
 
-static void updateRouting(OPEN_segaapiBuffer_t* buffer)
+// Requires g_buffersMutex.
+static void freeRetiredBuffers()
 {
-	if (!buffer->pendingRouting) return;
+	size_t kept = 0;
 
-	if (!buffer->dsBuffer)
+	for (size_t i = 0; i < g_retiredBuffers.size(); i++)
 	{
-		info("updateRouting: No dsBuffer, skipping");
-		buffer->pendingRouting = false;
-		return;
+		OPEN_segaapiBuffer_t* buffer = g_retiredBuffers[i];
+
+		if (buffer->voice.retired.load(std::memory_order_acquire))
+			freeBuffer(buffer);
+		else
+			g_retiredBuffers[kept++] = buffer;
 	}
 
-	DWORD dsStatus = 0;
-	buffer->dsBuffer->GetStatus(&dsStatus);
-	bool dsPlaying = (dsStatus & DSBSTATUS_PLAYING) != 0;
+	g_retiredBuffers.resize(kept);
+}
 
-	info("updateRouting: ===== ROUTING DEBUG START =====");
-	info("updateRouting: Buffer channels=%d, DSoundPlaying=%d, Loop=%d",
-		buffer->channels, dsPlaying, buffer->loop);
+static MixerCommand voiceCommand(OPEN_segaapiBuffer_t* buffer, MixerCommandType type, unsigned int index = 0, int param = 0, float value = 0.0f)
+{
+	MixerCommand command;
+	command.type = type;
+	command.voice = &buffer->voice;
+	command.index = index;
+	command.param = param;
+	command.channel = 0;
+	command.value = value;
+	return command;
+}
 
-	for (int i = 0; i < 7; i++)
-	{
-		info("updateRouting: Send[%d]: route=%d, channel=%d, volume=%f",
-			i, buffer->sendRoutes[i], buffer->sendChannels[i], buffer->sendVolumes[i]);
-	}
+static MixerCommand sendCommand(OPEN_segaapiBuffer_t* buffer, unsigned int send)
+{
+	MixerCommand command = voiceCommand(buffer, MIXER_CMD_SET_SEND, send, buffer->sendRoutes[send], buffer->sendVolumes[send]);
+	command.channel = buffer->sendChannels[send];
+	return command;
+}
 
-	bool usedPort[6] = { false };
-	float levels[6][6] = { 0.0f };
-	int numValidRoutes = 0;
+static void submitBatch(CommandBatch& batch)
+{
+	mixerSubmit(batch.large.empty() ? batch.commands : batch.large.data(), batch.count);
+	batch.large.clear();
+	batch.count = 0;
+}
 
-	for (int port = 0; port < 6; port++)
+static void queueCommand(CommandBatch& batch, const MixerCommand& command)
+{
+	if (batch.count < MAX_BATCH_COMMANDS)
 	{
-		for (int ch = 0; ch < 6; ch++)
-		{
-			levels[port][ch] = 0.0f;
-		}
+		batch.commands[batch.count++] = command;
+		return;
 	}
 
-	for (int i = 0; i < 7; i++)
-	{
-		if (buffer->sendRoutes[i] == OPEN_HA_UNUSED_PORT ||
-			buffer->sendRoutes[i] < 0 ||
-			buffer->sendRoutes[i] >= 6 ||
-			buffer->sendVolumes[i] <= 0.0f)
-		{
-			continue;
-		}
-
-		int destPort = buffer->sendRoutes[i];
-		int srcChannel = buffer->sendChannels[i];
-
-		if (srcChannel < 0 || srcChannel >= (int)buffer->channels || srcChannel >= 6)
-		{
-			info("updateRouting: WARNING - Send %d has invalid srcChannel %d (buffer has %d channels)",
-				i, srcChannel, buffer->channels);
-			continue;
-		}
-
-		usedPort[destPort] = true;
+	if (batch.large.empty())
+		batch.large.assign(batch.commands, batch.commands + batch.count);
 
-		float level = buffer->sendVolumes[i] * buffer->channelVolumes[srcChannel];
-		levels[destPort][srcChannel] += level;
+	batch.large.push_back(command);
+	batch.count++;
+}
 
-		numValidRoutes++;
+static void submitCommand(const MixerCommand& command)
+{
+	mixerSubmit(&command, 1);
+}
 
-		info("updateRouting: Send %d - SrcChan %d -> DestPort %d, Level %f", i, srcChannel, destPort, level);
-	}
+// Device layout from OPENSEGAAPI_SPEAKERS: stereo (default), quad or 5.1
+static unsigned int getOutputChannels()
+{
+	const char* speakers = getenv("OPENSEGAAPI_SPEAKERS");
 
-	if (numValidRoutes == 0)
-	{
-		info("updateRouting: No valid routes found, skipping");
-		buffer->pendingRouting = false;
-		return;
-	}
+	if (speakers == nullptr || strcmp(speakers, "stereo") == 0)
+		return 2;
+	if (strcmp(speakers, "quad") == 0)
+		return 4;
+	if (strcmp(speakers, "5.1") == 0)
+		return 6;
 
-	// Check if center channel is being used
-	bool hasCenterChannel = false;
-	int centerChannelIndex = -1;
-	float centerVolume = 0.0f;
+	info("getOutputChannels: Unknown speaker layout %s, using stereo", speakers);
+	return 2;
+}
 
+// Falls back to plain stereo routing when the game never set up a usable send.
+static void ensureDefaultRouting(OPEN_segaapiBuffer_t* buffer, CommandBatch& batch)
+{
 	for (int i = 0; i < 7; i++)
 	{
-		if (buffer->sendRoutes[i] == OPEN_HA_FRONT_CENTER_PORT && buffer->sendVolumes[i] > 0.0f)
+		if (buffer->sendRoutes[i] != OPEN_HA_UNUSED_PORT &&
+			buffer->sendRoutes[i] >= 0 &&
+			(buffer->sendRoutes[i] < 6 ||
+			(buffer->sendRoutes[i] >= OPEN_HA_FXSLOT0_PORT && buffer->sendRoutes[i] <= OPEN_HA_FXSLOT3_PORT)))
 		{
-			hasCenterChannel = true;
-			centerChannelIndex = buffer->sendChannels[i];
-			centerVolume = buffer->sendVolumes[i];
-			info("updateRouting: DETECTED center channel routing - send[%d] using channel %d with volume %f",
-				i, centerChannelIndex, centerVolume);
-			break;
+			return;
 		}
 	}
 
-	// Detect LFE/Subwoofer channel usage and calculate its level
-	bool hasLFE = false;
-	float lfeLevel = 0.0f;
+	info("ensureDefaultRouting: No valid routes, setting up default stereo routing");
+	buffer->sendRoutes[0] = OPEN_HA_FRONT_LEFT_PORT;
+	buffer->sendRoutes[1] = OPEN_HA_FRONT_RIGHT_PORT;
+	buffer->sendVolumes[0] = 1.0f;
+	buffer->sendVolumes[1] = 1.0f;
+	buffer->sendChannels[0] = 0;
+	buffer->sendChannels[1] = 1;
+	queueCommand(batch, sendCommand(buffer, 0));
+	queueCommand(batch, sendCommand(buffer, 1));
+}
 
-	for (int i = 0; i < 7; i++)
-	{
-		if (buffer->sendRoutes[i] == OPEN_HA_LFE_PORT && buffer->sendVolumes[i] > 0.0f)
-		{
-			hasLFE = true;
-			int srcChannel = buffer->sendChannels[i];
-			if (srcChannel >= 0 && srcChannel < (int)buffer->channels && srcChannel < 6)
-			{
-				float level = buffer->sendVolumes[i] * buffer->channelVolumes[srcChannel];
-				lfeLevel = max(lfeLevel, level);
-			}
-			info("updateRouting: DETECTED LFE/Subwoofer routing - send[%d] with volume %f, level=%f",
-				i, buffer->sendVolumes[i], lfeLevel);
-		}
-	}
+static void startVoice(OPEN_segaapiBuffer_t* buffer, CommandBatch& batch)
+{
+	ensureDefaultRouting(buffer, batch);
 
-	float overallVolume = 0.0f;
+	// The mixer decides where the voice starts, it knows whether it is still running
+	buffer->playing = true;
+	buffer->paused = false;
+	buffer->playSerial++;
+	queueCommand(batch, voiceCommand(buffer, MIXER_CMD_PLAY, 0, (int)buffer->playSerial));
+}
 
-	// Calculate volume from stereo channels
-	for (int port = 0; port < 6; port++)
-	{
-		// Skip LFE port (port 3) when calculating stereo volume
-		if (port == OPEN_HA_LFE_PORT)
-		{
-			continue;
-		}
+// Notification points are set by byte offset but kept as the frame holding it, so two
+// offsets into the same frame are the same point.
+static OPEN_SEGASTATUS setNotificationPoint(OPEN_segaapiBuffer_t* buffer, CommandBatch& batch, unsigned int offset)
+{
+	if (offset >= buffer->size)
+		return OPEN_SEGAERR_BAD_PARAM;
 
-		if (usedPort[port])
-		{
-			for (int ch = 0; ch < (int)buffer->channels && ch < 6; ch++)
-			{
-				overallVolume = max(overallVolume, levels[port][ch]);
-			}
-		}
-	}
+	unsigned int frame = offset / buffer->format.nBlockAlign;
 
-	// Bass management
-	if (hasLFE && overallVolume < 0.0001f)
-	{
-		// LFE-only audio (like car engine) - downmix to stereo at -20dB
-		overallVolume = lfeLevel * 0.1f;
-		info("updateRouting: LFE-only audio detected - downmixing to stereo at reduced level: %f", overallVolume);
-	}
-	else if (hasLFE && overallVolume > 0.0001f)
+	for (unsigned int i = 0; i < buffer->notifyPointCount; i++)
 	{
-		// Mix LFE with existing stereo channels at lower level at -22dB
-		float lfeContribution = lfeLevel * 0.08f;
-		overallVolume = max(overallVolume, lfeContribution);
-		info("updateRouting: LFE mixed with stereo - LFE contribution: %f, total: %f", lfeContribution, overallVolume);
+		if (buffer->notifyPoints[i] == frame)
+			return OPEN_SEGA_SUCCESS;
 	}
 
-	info("updateRouting: Channels=%d, Calculated overallVolume=%f (LFE downmixed if present)", buffer->channels, overallVolume);
+	if (buffer->notifyPointCount == MIXER_MAX_NOTIFY_POINTS)
+		return OPEN_SEGAERR_FAIL;
 
-	float finalVolume = overallVolume * buffer->masterVolume;
+	buffer->notifyPoints[buffer->notifyPointCount++] = frame;
+	queueCommand(batch, voiceCommand(buffer, MIXER_CMD_SET_NOTIFY_POINT, 0, (int)frame));
+	return OPEN_SEGA_SUCCESS;
+}
 
-	float globalVolumeFactor = 1.0f;
-	for (int i = 0; i < 7; i++)
+static OPEN_SEGASTATUS clearNotificationPoint(OPEN_segaapiBuffer_t* buffer, CommandBatch& batch, unsigned int offset)
+{
+	if (offset >= buffer->size)
+		return OPEN_SEGAERR_BAD_PARAM;
+
+	unsigned int frame = offset / buffer->format.nBlockAlign;
+
+	for (unsigned int i = 0; i < buffer->notifyPointCount; i++)
 	{
-		if (buffer->sendRoutes[i] != OPEN_HA_UNUSED_PORT && buffer->sendVolumes[i] > 0.0f)
+		if (buffer->notifyPoints[i] == frame)
 		{
-			int physPort = -1;
-			switch (buffer->sendRoutes[i])
-			{
-			case OPEN_HA_FRONT_LEFT_PORT:
-				physPort = OPEN_HA_OUT_FRONT_LEFT;
-				break;
-			case OPEN_HA_FRONT_RIGHT_PORT:
-				physPort = OPEN_HA_OUT_FRONT_RIGHT;
-				break;
-			case OPEN_HA_FRONT_CENTER_PORT:
-				physPort = OPEN_HA_OUT_FRONT_CENTER;
-				break;
-			case OPEN_HA_LFE_PORT:
-				// Include LFE master volume for downmixed audio
-				physPort = OPEN_HA_OUT_LFE_PORT;
-				break;
-			case OPEN_HA_REAR_LEFT_PORT:
-				physPort = OPEN_HA_OUT_REAR_LEFT;
-				break;
-			case OPEN_HA_REAR_RIGHT_PORT:
-				physPort = OPEN_HA_OUT_REAR_RIGHT;
-				break;
-			}
-
-			if (physPort >= 0 && physPort < 12)
-			{
-				globalVolumeFactor = max(globalVolumeFactor, g_masterVolumes[physPort]);
-			}
+			buffer->notifyPoints[i] = buffer->notifyPoints[--buffer->notifyPointCount];
+			queueCommand(batch, voiceCommand(buffer, MIXER_CMD_CLEAR_NOTIFY_POINT, 0, (int)frame));
+			return OPEN_SEGA_SUCCESS;
 		}
 	}
 
-	finalVolume *= globalVolumeFactor;
+	return OPEN_SEGAERR_BAD_PARAM;
+}
 
-	long dsVolume = DSBVOLUME_MIN;
-	if (finalVolume > 0.00001f)
-	{
-		dsVolume = (long)(2000.0f * log10(finalVolume));
-		dsVolume = max(DSBVOLUME_MIN, min(DSBVOLUME_MAX, dsVolume));
+// Every frameCount frames played, loops included. Zero turns it off.
+static void setNotificationFrequency(OPEN_segaapiBuffer_t* buffer, CommandBatch& batch, unsigned int frameCount)
+{
+	buffer->notifyFrequency = frameCount;
+	queueCommand(batch, voiceCommand(buffer, MIXER_CMD_SET_NOTIFY_INTERVAL, 0, (int)frameCount));
+}
+
+static void setVoiceParam(OPEN_segaapiBuffer_t* buffer, CommandBatch& batch, OPEN_VOICEIOCTL ioctl, unsigned int dwParam1)
+{
+	switch (ioctl)
+	{
+	case OPEN_VOICEIOCTL_SET_START_LOOP_OFFSET:
+		buffer->startLoop = dwParam1;
+		queueCommand(batch, voiceCommand(buffer, MIXER_CMD_SET_START_LOOP, 0, (int)dwParam1));
+		break;
+	case OPEN_VOICEIOCTL_SET_END_LOOP_OFFSET:
+		buffer->endLoop = dwParam1;
+		queueCommand(batch, voiceCommand(buffer, MIXER_CMD_SET_END_LOOP, 0, (int)dwParam1));
+		break;
+	case OPEN_VOICEIOCTL_SET_END_OFFSET:
+		buffer->endOffset = dwParam1;
+		queueCommand(batch, voiceCommand(buffer, MIXER_CMD_SET_END_OFFSET, 0, (int)dwParam1));
+		break;
+	case OPEN_VOICEIOCTL_SET_PLAY_POSITION:
+		if (dwParam1 < buffer->size)
+		{
+			unsigned int frame = dwParam1 / buffer->format.nBlockAlign;
+
+			// Reported right away, the mixer moves the voice at its next period
+			buffer->voice.position.store(frame, std::memory_order_relaxed);
+			queueCommand(batch, voiceCommand(buffer, MIXER_CMD_SET_POSITION, 0, (int)frame));
+		}
+		break;
+	case OPEN_VOICEIOCTL_SET_LOOP_STATE:
+		buffer->loop = dwParam1 != 0;
+		queueCommand(batch, voiceCommand(buffer, MIXER_CMD_SET_LOOP_STATE, 0, buffer->loop ? 1 : 0));
+		break;
+	case OPEN_VOICEIOCTL_SET_NOTIFICATION_POINT:
+		if (setNotificationPoint(buffer, batch, dwParam1) != OPEN_SEGA_SUCCESS)
+			info("setVoiceParam: Notification point %08X not set", dwParam1);
+		break;
+	case OPEN_VOICEIOCTL_CLEAR_NOTIFICATION_POINT:
+		if (clearNotificationPoint(buffer, batch, dwParam1) != OPEN_SEGA_SUCCESS)
+			info("setVoiceParam: Notification point %08X not cleared", dwParam1);
+		break;
+	case OPEN_VOICEIOCTL_SET_NOTIFICATION_FREQUENCY:
+		setNotificationFrequency(buffer, batch, dwParam1);
+		break;
 	}
+}
 
-	HRESULT hr = buffer->dsBuffer->SetVolume(dsVolume);
-	if (FAILED(hr))
+static void setSynthParam(OPEN_segaapiBuffer_t* buffer, CommandBatch& batch, OPEN_HASYNTHPARAMSEXT param, int lPARWValue)
+{
+	if (param == OPEN_HAVP_ATTENUATION)
 	{
-		info("updateRouting: SetVolume FAILED: 0x%08x", hr);
-	}
+		long attenuationDB = -(long)(lPARWValue * 10);
 
-	// Calculate pan based on left/right routing levels
-	long dsPan = 0;
+		// Store as linear gain for routing calculations
+		buffer->masterVolume = powf(10.0f, attenuationDB / 2000.0f);
+		queueCommand(batch, voiceCommand(buffer, MIXER_CMD_SET_MASTER_VOLUME, 0, 0, buffer->masterVolume));
 
-	// Check if any channel is sent to BOTH left and right
-	bool channelSentToBoth[6] = { false };
-	for (int ch = 0; ch < 6; ch++)
+		info("setSynthParam: OPEN_HAVP_ATTENUATION dB: %d (-%f dB), gain: %f",
+			lPARWValue, lPARWValue / 10.0f, buffer->masterVolume);
+	}
+	else if (param == OPEN_HAVP_PITCH)
 	{
-		bool toLeft = false;
-		bool toRight = false;
+		float semiTones = lPARWValue / 100.0f;
+		float freqRatio = powf(2.0f, semiTones / 12.0f);
 
-		for (int i = 0; i < 7; i++)
-		{
-			if (buffer->sendRoutes[i] != OPEN_HA_UNUSED_PORT && buffer->sendVolumes[i] > 0.0f)
-			{
-				// Skip LFE for pan calculation (LFE is non-directional)
-				if (buffer->sendRoutes[i] == OPEN_HA_LFE_PORT)
-					continue;
-
-				if (buffer->sendChannels[i] == ch)
-				{
-					if (buffer->sendRoutes[i] == OPEN_HA_FRONT_LEFT_PORT || buffer->sendRoutes[i] == OPEN_HA_REAR_LEFT_PORT)
-						toLeft = true;
-					if (buffer->sendRoutes[i] == OPEN_HA_FRONT_RIGHT_PORT || buffer->sendRoutes[i] == OPEN_HA_REAR_RIGHT_PORT)
-						toRight = true;
-				}
-			}
-		}
+		// Keep the playback rate inside the range DirectSound used to accept
+		float newFreq = buffer->sampleRate * freqRatio;
+		newFreq = std::max((float)MIXER_MIN_VOICE_RATE, std::min((float)MIXER_MAX_VOICE_RATE, newFreq));
+		buffer->frequency = newFreq / buffer->sampleRate;
+		queueCommand(batch, voiceCommand(buffer, MIXER_CMD_SET_RATE, 0, (int)buffer->sampleRate, buffer->frequency));
 
-		if (toLeft && toRight)
-		{
-			channelSentToBoth[ch] = true;
-			info("updateRouting: Channel %d is sent to BOTH L/R - will CENTER (Pan=0)", ch);
-		}
+		info("setSynthParam: OPEN_HAVP_PITCH hHandle: %08X semitones: %f freqRatio: %f", buffer, semiTones, freqRatio);
 	}
-
-	// If ANY channel is sent to both L/R, force center pan
-	bool hasDuplicateRouting = false;
-	for (int ch = 0; ch < 6; ch++)
+	else if (param == OPEN_HAVP_SUSTAIN_VOL_ENV)
 	{
-		if (channelSentToBoth[ch])
-		{
-			hasDuplicateRouting = true;
-			break;
-		}
+		// Centibels below the peak, SF2 style
+		float level = lPARWValue <= 0 ? 1.0f : lPARWValue >= 1000 ? 0.0f : powf(10.0f, -lPARWValue / 200.0f);
+		queueCommand(batch, voiceCommand(buffer, MIXER_CMD_SET_SYNTH_PARAM, param, 0, level));
 	}
-
-	if (hasDuplicateRouting || (hasLFE && overallVolume > 0 && overallVolume <= lfeLevel * 0.6f))
+	else if (param == OPEN_HAVP_SUSTAIN_MOD_ENV)
 	{
-		// Force centered pan for duplicated routing OR LFE-dominant audio
-		dsPan = 0;
-		info("updateRouting: Duplicate routing or LFE-dominant - FORCING center pan (0)");
+		// Tenths of a percent below the peak
+		float level = 1.0f - std::max(0, std::min(1000, lPARWValue)) / 1000.0f;
+		queueCommand(batch, voiceCommand(buffer, MIXER_CMD_SET_SYNTH_PARAM, param, 0, level));
 	}
-	else
+	else if ((param >= OPEN_HAVP_DELAY_VOL_ENV && param <= OPEN_HAVP_RELEASE_VOL_ENV) ||
+		(param >= OPEN_HAVP_DELAY_MOD_ENV && param <= OPEN_HAVP_RELEASE_MOD_ENV))
 	{
-		// Normal pan calculation - sum up left and right channel levels
-		float leftLevel = 0.0f;
-		float rightLevel = 0.0f;
+		// Timecents, anything from -12000 down is instantaneous
+		float seconds = lPARWValue <= -12000 ? 0.0f : powf(2.0f, lPARWValue / 1200.0f);
+		queueCommand(batch, voiceCommand(buffer, MIXER_CMD_SET_SYNTH_PARAM, param, 0, seconds));
 
-		for (int i = 0; i < 7; i++)
-		{
-			if (buffer->sendRoutes[i] != OPEN_HA_UNUSED_PORT && buffer->sendVolumes[i] > 0.0f)
-			{
-				// Skip LFE for pan calculation (LFE is non-directional, so it goes to center)
-				if (buffer->sendRoutes[i] == OPEN_HA_LFE_PORT)
-				{
-					continue;
-				}
-
-				int srcChannel = buffer->sendChannels[i];
-				if (srcChannel >= 0 && srcChannel < (int)buffer->channels && srcChannel < 6)
-				{
-					float level = buffer->sendVolumes[i] * buffer->channelVolumes[srcChannel];
-
-					if (buffer->sendRoutes[i] == OPEN_HA_FRONT_LEFT_PORT || buffer->sendRoutes[i] == OPEN_HA_REAR_LEFT_PORT)
-						leftLevel += level;
-					else if (buffer->sendRoutes[i] == OPEN_HA_FRONT_RIGHT_PORT || buffer->sendRoutes[i] == OPEN_HA_REAR_RIGHT_PORT)
-						rightLevel += level;
-					else if (buffer->sendRoutes[i] == OPEN_HA_FRONT_CENTER_PORT)
-					{
-						// Center channel: add to BOTH left and right
-						leftLevel += level;
-						rightLevel += level;
-					}
-				}
-			}
-		}
-
-		// Calculate pan: -10000 (full left) to +10000 (full right)
-		if (leftLevel > 0.0f || rightLevel > 0.0f)
-		{
-			float totalLevel = leftLevel + rightLevel;
-			float balance = (rightLevel - leftLevel) / totalLevel; // -1.0 to +1.0
-			dsPan = (long)(balance * 10000.0f);
-			dsPan = max(-10000L, min(10000L, dsPan));
-		}
-
-		info("updateRouting: Pan calculation - Left=%f Right=%f Balance=%f Pan=%d",
-			leftLevel, rightLevel, (leftLevel + rightLevel > 0) ? (rightLevel - leftLevel) / (leftLevel + rightLevel) : 0.0f, dsPan);
+		info("setSynthParam: Envelope param %d hHandle: %08X seconds: %f", param, buffer, seconds);
 	}
-
-	hr = buffer->dsBuffer->SetPan(dsPan);
-	if (FAILED(hr))
+	else if (param == OPEN_HAVP_DELAY_MOD_LFO || param == OPEN_HAVP_DELAY_VIB_LFO)
 	{
-		info("updateRouting: SetPan FAILED: 0x%08x", hr);
+		float seconds = lPARWValue <= -12000 ? 0.0f : powf(2.0f, lPARWValue / 1200.0f);
+		queueCommand(batch, voiceCommand(buffer, MIXER_CMD_SET_SYNTH_PARAM, param, 0, seconds));
 	}
-	buffer->pan = dsPan;
-
-	long verifyVolume = 0;
-	buffer->dsBuffer->GetVolume(&verifyVolume);
-
-	buffer->pendingRouting = false;
-	info("updateRouting: Final - Volume=%d dB (verify=%d), overall=%f, master=%f, final=%f, global=%f, Pan=%d, Channels=%d, HasCenter=%d, HasLFE=%d (level=%f), DSPlaying=%d",
-		dsVolume, verifyVolume, overallVolume, buffer->masterVolume, finalVolume, globalVolumeFactor, dsPan, buffer->channels, hasCenterChannel, hasLFE, lfeLevel, dsPlaying);
-	info("updateRouting: ===== ROUTING DEBUG END =====");
-}
-
-static void updateBufferNew(OPEN_segaapiBuffer_t* buffer, unsigned int offset, size_t length)
-{
-	info("updateBufferNew offset=%08X length=%08X, loop=%d, startLoop=%08X, endLoop=%08X, endOffset=%08X",
-		offset, length, buffer->loop, buffer->startLoop, buffer->endLoop, buffer->endOffset);
-
-	if (buffer->dsBuffer == NULL || buffer->data == nullptr)
+	else if (param == OPEN_HAVP_FREQ_MOD_LFO || param == OPEN_HAVP_FREQ_VIB_LFO)
 	{
-		info("updateBufferNew: Invalid buffer state");
-		return;
-	}
-
-	// Calculate the actual audio region to play
-	unsigned int playStartOffset = buffer->startLoop;
-	unsigned int playEndOffset = buffer->loop ? buffer->endLoop : buffer->endOffset;
-
-	// Clamp to buffer size
-	if (playStartOffset >= buffer->size) playStartOffset = 0;
-	if (playEndOffset > buffer->size) playEndOffset = buffer->size;
-	if (playEndOffset <= playStartOffset) playEndOffset = buffer->size;
-
-	unsigned int bytesToPlay = playEndOffset - playStartOffset;
-
-	info("updateBufferNew: Calculated play region: start=%08X end=%08X length=%08X",
-		playStartOffset, playEndOffset, bytesToPlay);
+		// Absolute cents, 0 is 8.176 Hz. Kept to the SF2 range, up to about 100 Hz.
+		float hertz = 8.176f * powf(2.0f, std::max(-16000, std::min(4500, lPARWValue)) / 1200.0f);
+		queueCommand(batch, voiceCommand(buffer, MIXER_CMD_SET_SYNTH_PARAM, param, 0, hertz));
 
-	// Get current DirectSound buffer size
-	DSBCAPS caps;
-	ZeroMemory(&caps, sizeof(DSBCAPS));
-	caps.dwSize = sizeof(DSBCAPS);
-	HRESULT hr = buffer->dsBuffer->GetCaps(&caps);
-	if (FAILED(hr))
-	{
-		info("updateBufferNew: GetCaps failed: 0x%08x", hr);
-		return;
+		info("setSynthParam: LFO param %d hHandle: %08X Hz: %f", param, buffer, hertz);
 	}
-
-	// Check status and restore if lost
-	DWORD status = 0;
-	hr = buffer->dsBuffer->GetStatus(&status);
-	if (FAILED(hr))
+	else if (param == OPEN_HAVP_MOD_ENV_TO_PITCH || param == OPEN_HAVP_MOD_LFO_TO_PITCH ||
+		param == OPEN_HAVP_VIB_LFO_TO_PITCH || param == OPEN_HAVP_MOD_LFO_TO_ATTENUATION)
 	{
-		info("updateBufferNew: GetStatus failed: 0x%08x", hr);
-		return;
+		// Cents, or centibels for the attenuation, at the envelope's or LFO's peak
+		queueCommand(batch, voiceCommand(buffer, MIXER_CMD_SET_SYNTH_PARAM, param, 0, (float)lPARWValue));
 	}
+	else if (param == OPEN_HAVP_FILTER_CUTOFF || param == OPEN_HAVP_MOD_ENV_TO_FILTER_CUTOFF || param == OPEN_HAVP_MOD_LFO_TO_FILTER_CUTOFF)
+	{
+		// Absolute cents for the cutoff, cents at the peak for the modulation. The mixer
+		// keeps the sum to MIXER_MIN_CUTOFF..MIXER_MAX_CUTOFF, bypassing the filter at the top.
+		queueCommand(batch, voiceCommand(buffer, MIXER_CMD_SET_SYNTH_PARAM, param, 0, (float)lPARWValue));
 
-	if (status & DSBSTATUS_BUFFERLOST)
+		info("setSynthParam: Filter param %d hHandle: %08X cents: %d", param, buffer, lPARWValue);
+	}
+	else if (param == OPEN_HAVP_FILTER_Q)
 	{
-		hr = buffer->dsBuffer->Restore();
-		if (FAILED(hr)) return;
+		// Centibels of resonance, sent as the 1/Q the filter takes, the way tsf does
+		float qInv = 1.0f / powf(10.0f, std::max(0, std::min(960, lPARWValue)) / 200.0f);
+		queueCommand(batch, voiceCommand(buffer, MIXER_CMD_SET_SYNTH_PARAM, param, 0, qInv));
 	}
+}
 
-	bool isCurrentlyPlaying = (status & DSBSTATUS_PLAYING) != 0;
+// EAX's generic environment, what a reverb starts out as
+static const EAXREVERBPROPERTIES g_genericReverb =
+{
+	0, 7.5f, 1.0f, -1000, -100, 0, 1.49f, 0.83f, 1.0f, -2602, 0.007f, { 0.0f, 0.0f, 0.0f },
+	200, 0.011f, { 0.0f, 0.0f, 0.0f }, 0.25f, 0.0f, 0.25f, 0.0f, -5.0f, 5000.0f, 250.0f, 0.0f, 0x3f
+};
 
-	// Lock and update the DirectSound buffer
-	void* ptr1 = nullptr;
-	void* ptr2 = nullptr;
-	DWORD bytes1 = 0, bytes2 = 0;
+// Size, decay time and decay HF ratio of the EAX environments, generic to psychotic.
+// Picking one sets those, the levels and delays stay as they are.
+static const float g_reverbEnvironments[][3] =
+{
+	{ 7.5f, 1.49f, 0.83f }, { 1.4f, 0.17f, 0.10f }, { 1.9f, 0.40f, 0.83f }, { 1.4f, 1.49f, 0.54f },
+	{ 2.5f, 0.50f, 0.10f }, { 11.6f, 2.31f, 0.64f }, { 21.6f, 4.32f, 0.59f }, { 19.6f, 3.92f, 0.70f },
+	{ 14.6f, 2.91f, 1.30f }, { 36.2f, 7.24f, 0.33f }, { 50.3f, 10.05f, 0.23f }, { 1.9f, 0.30f, 0.10f },
+	{ 1.8f, 1.49f, 0.59f }, { 13.5f, 2.70f, 0.79f }, { 7.5f, 1.49f, 0.86f }, { 38.0f, 1.49f, 0.54f },
+	{ 7.5f, 1.49f, 0.67f }, { 100.0f, 1.49f, 0.21f }, { 17.5f, 1.49f, 0.83f }, { 42.5f, 1.49f, 0.50f },
+	{ 8.3f, 1.65f, 1.50f }, { 1.7f, 2.81f, 0.14f }, { 1.8f, 1.49f, 0.10f }, { 1.9f, 8.39f, 1.39f },
+	{ 1.8f, 17.23f, 0.56f }, { 1.0f, 7.56f, 0.91f }
+};
+
+static int fxSlotIndex(const GUID* guid)
+{
+	const GUID* slots[MIXER_FX_SLOTS] = {
+		&EAXPROPERTYID_EAX40_FXSlot0, &EAXPROPERTYID_EAX40_FXSlot1,
+		&EAXPROPERTYID_EAX40_FXSlot2, &EAXPROPERTYID_EAX40_FXSlot3
+	};
 
-	hr = buffer->dsBuffer->Lock(0, caps.dwBufferBytes, &ptr1, &bytes1, &ptr2, &bytes2, 0);
-	if (FAILED(hr))
+	for (int slot = 0; slot < MIXER_FX_SLOTS; slot++)
 	{
-		info("updateBufferNew: Failed to lock: 0x%08x", hr);
-		return;
+		if (memcmp(guid, slots[slot], sizeof(GUID)) == 0)
+			return slot;
 	}
 
-	// For looping, tile the loop data to fill the entire DirectSound buffer
-	if (buffer->loop && bytesToPlay < caps.dwBufferBytes)
-	{
-		size_t bytesWritten = 0;
-		uint8_t* destPtr = (uint8_t*)ptr1;
+	return -1;
+}
 
-		// Keep copying the loop region until we fill the DirectSound buffer
-		while (bytesWritten < bytes1)
-		{
-			size_t chunkSize = min((size_t)(bytes1 - bytesWritten), (size_t)bytesToPlay);
+static float millibelsToGain(int millibels)
+{
+	return powf(10.0f, millibels / 2000.0f);
+}
 
-			int channelToDuplicate = getChannelToDuplicate(buffer);
-			if (channelToDuplicate >= 0)
-			{
-				duplicateChannelToStereo(destPtr, buffer->data + playStartOffset, chunkSize, channelToDuplicate);
-			}
-			else
-			{
-				memcpy(destPtr, buffer->data + playStartOffset, chunkSize);
-			}
+static void queueFxParam(CommandBatch& batch, unsigned int slot, unsigned int property, float value)
+{
+	MixerCommand command = {};
+	command.type = MIXER_CMD_SET_FX_PARAM;
+	command.index = slot;
+	command.param = (int)property;
+	command.value = value;
+	queueCommand(batch, command);
+}
 
-			destPtr += chunkSize;
-			bytesWritten += chunkSize;
-		}
+// Hands the mixer every reverb property it uses, in the units ReverbParameters has
+static void queueReverb(CommandBatch& batch, unsigned int slot)
+{
+	const EAXREVERBPROPERTIES& reverb = g_fxReverbs[slot];
+
+	queueFxParam(batch, slot, EAXREVERB_ENVIRONMENTSIZE, reverb.flEnvironmentSize);
+	queueFxParam(batch, slot, EAXREVERB_ENVIRONMENTDIFFUSION, reverb.flEnvironmentDiffusion);
+	queueFxParam(batch, slot, EAXREVERB_ROOM, millibelsToGain(reverb.lRoom));
+	queueFxParam(batch, slot, EAXREVERB_ROOMHF, millibelsToGain(reverb.lRoomHF));
+	queueFxParam(batch, slot, EAXREVERB_DECAYTIME, reverb.flDecayTime);
+	queueFxParam(batch, slot, EAXREVERB_DECAYHFRATIO, reverb.flDecayHFRatio);
+	queueFxParam(batch, slot, EAXREVERB_REFLECTIONS, millibelsToGain(reverb.lReflections));
+	queueFxParam(batch, slot, EAXREVERB_REFLECTIONSDELAY, reverb.flReflectionsDelay);
+	queueFxParam(batch, slot, EAXREVERB_REVERB, millibelsToGain(reverb.lReverb));
+	queueFxParam(batch, slot, EAXREVERB_REVERBDELAY, reverb.flReverbDelay);
+	queueFxParam(batch, slot, EAXREVERB_HFREFERENCE, reverb.flHFReference);
+}
 
-		// Handle wrapped buffer (ptr2)
-		if (ptr2 && bytes2 > 0)
-		{
-			bytesWritten = 0;
-			destPtr = (uint8_t*)ptr2;
+// A null GUID empties the slot, anything else loads the reverb with its defaults
+static void loadFxEffect(CommandBatch& batch, unsigned int slot, const GUID& effect)
+{
+	static const GUID none = {};
+	bool loaded = memcmp(&effect, &none, sizeof(GUID)) != 0;
 
-			while (bytesWritten < bytes2)
-			{
-				size_t chunkSize = min((size_t)(bytes2 - bytesWritten), (size_t)bytesToPlay);
-
-				int channelToDuplicate = getChannelToDuplicate(buffer);
-				if (channelToDuplicate >= 0)
-				{
-					duplicateChannelToStereo(destPtr, buffer->data + playStartOffset, chunkSize, channelToDuplicate);
-				}
-				else
-				{
-					memcpy(destPtr, buffer->data + playStartOffset, chunkSize);
-				}
-
-				destPtr += chunkSize;
-				bytesWritten += chunkSize;
-			}
-		}
-	}
-	else
-	{
-		// Non-looping or loop fits in buffer - normal copy
-		size_t bytesToCopy = min((size_t)bytes1, (size_t)bytesToPlay);
-		if (ptr1 && bytes1 > 0)
-		{
-			int channelToDuplicate = getChannelToDuplicate(buffer);
+	g_fxSlots[slot].guidLoadEffect = effect;
+	g_fxReverbs[slot] = g_genericReverb;
 
-			if (channelToDuplicate >= 0)
-			{
-				duplicateChannelToStereo(ptr1, buffer->data + playStartOffset, bytesToCopy, channelToDuplicate);
-			}
-			else
-			{
-				memcpy(ptr1, buffer->data + playStartOffset, bytesToCopy);
-			}
+	queueFxParam(batch, slot, EAXFXSLOT_LOADEFFECT, loaded ? 1.0f : 0.0f);
+	queueFxParam(batch, slot, EAXFXSLOT_VOLUME, millibelsToGain(g_fxSlots[slot].lVolume));
 
-			// Zero out any remaining space
-			if (bytes1 > bytesToCopy)
-			{
-				memset((uint8_t*)ptr1 + bytesToCopy, 0, bytes1 - bytesToCopy);
-			}
-		}
+	info("loadFxEffect: FX slot %d %s", slot, loaded ? "reverb" : "empty");
+}
 
-		// Handle wrapped buffer
-		if (ptr2 && bytes2 > 0)
-		{
-			size_t remainingData = (bytesToPlay > bytesToCopy) ? (bytesToPlay - bytesToCopy) : 0;
-			size_t bytes2ToCopy = min((size_t)bytes2, remainingData);
-			if (bytes2ToCopy > 0)
-			{
-				int channelToDuplicate = getChannelToDuplicate(buffer);
-
-				if (channelToDuplicate >= 0)
-				{
-					duplicateChannelToStereo(ptr2, buffer->data + playStartOffset + bytesToCopy, bytes2ToCopy, channelToDuplicate);
-				}
-				else
-				{
-					memcpy(ptr2, buffer->data + playStartOffset + bytesToCopy, bytes2ToCopy);
-				}
-			}
-			if (bytes2 > bytes2ToCopy)
-			{
-				memset((uint8_t*)ptr2 + bytes2ToCopy, 0, bytes2 - bytes2ToCopy);
-			}
-		}
-	}
+static bool setFxProperty(CommandBatch& batch, unsigned int slot, unsigned int property, const void* data, unsigned long size)
+{
+	EAXFXSLOTPROPERTIES& fxSlot = g_fxSlots[slot];
+	EAXREVERBPROPERTIES& reverb = g_fxReverbs[slot];
 
-	buffer->dsBuffer->Unlock(ptr1, bytes1, ptr2, bytes2);
-	info("updateBufferNew: Updated DirectSound buffer with loop data");
+	// Every property is at least a 32-bit value
+	if (data == nullptr || size < sizeof(int))
+		return false;
 
-	// Start playback
-	if (!isCurrentlyPlaying)
+	switch (property)
 	{
-		buffer->dsBuffer->SetCurrentPosition(0);
+	case EAXFXSLOT_ALLPARAMETERS:
+	{
+		if (size < sizeof(EAXFXSLOTPROPERTIES))
+			return false;
 
-		DWORD playFlags = buffer->loop ? DSBPLAY_LOOPING : 0;
-		hr = buffer->dsBuffer->Play(0, 0, playFlags);
+		const EAXFXSLOTPROPERTIES& properties = *(const EAXFXSLOTPROPERTIES*)data;
+		fxSlot.lVolume = properties.lVolume;
+		fxSlot.lLock = properties.lLock;
+		fxSlot.ulFlags = properties.ulFlags;
 
-		if (SUCCEEDED(hr))
-		{
-			info("updateBufferNew: Started playback (loop=%s, DS buffer size=%d, loop region tiled throughout)",
-				buffer->loop ? "YES" : "NO", caps.dwBufferBytes);
-		}
+		if (memcmp(&properties.guidLoadEffect, &fxSlot.guidLoadEffect, sizeof(GUID)) != 0)
+			loadFxEffect(batch, slot, properties.guidLoadEffect);
 		else
-		{
-			info("updateBufferNew: Play failed: 0x%08x", hr);
-		}
+			queueFxParam(batch, slot, EAXFXSLOT_VOLUME, millibelsToGain(fxSlot.lVolume));
+		return true;
 	}
-	else
-	{
-		info("updateBufferNew: Buffer already playing - updated in place");
+	case EAXFXSLOT_LOADEFFECT:
+		if (size < sizeof(GUID))
+			return false;
+		loadFxEffect(batch, slot, *(const GUID*)data);
+		return true;
+	case EAXFXSLOT_VOLUME:
+		fxSlot.lVolume = *(const int*)data;
+		queueFxParam(batch, slot, EAXFXSLOT_VOLUME, millibelsToGain(fxSlot.lVolume));
+		return true;
+	case EAXFXSLOT_LOCK:
+		fxSlot.lLock = *(const int*)data;
+		return true;
+	case EAXFXSLOT_FLAGS:
+		fxSlot.ulFlags = *(const unsigned int*)data;
+		return true;
+	case EAXREVERB_ALLPARAMETERS:
+		if (size < sizeof(EAXREVERBPROPERTIES))
+			return false;
+		reverb = *(const EAXREVERBPROPERTIES*)data;
+		break;
+	case EAXREVERB_ENVIRONMENT:
+	{
+		unsigned int environment = *(const unsigned int*)data;
+		if (environment >= sizeof(g_reverbEnvironments) / sizeof(g_reverbEnvironments[0]))
+			return false;
+
+		reverb.ulEnvironment = environment;
+		reverb.flEnvironmentSize = g_reverbEnvironments[environment][0];
+		reverb.flDecayTime = g_reverbEnvironments[environment][1];
+		reverb.flDecayHFRatio = g_reverbEnvironments[environment][2];
+		break;
+	}
+	case EAXREVERB_ENVIRONMENTSIZE: reverb.flEnvironmentSize = *(const float*)data; break;
+	case EAXREVERB_ENVIRONMENTDIFFUSION: reverb.flEnvironmentDiffusion = *(const float*)data; break;
+	case EAXREVERB_ROOM: reverb.lRoom = *(const int*)data; break;
+	case EAXREVERB_ROOMHF: reverb.lRoomHF = *(const int*)data; break;
+	case EAXREVERB_ROOMLF: reverb.lRoomLF = *(const int*)data; break;
+	case EAXREVERB_DECAYTIME: reverb.flDecayTime = *(const float*)data; break;
+	case EAXREVERB_DECAYHFRATIO: reverb.flDecayHFRatio = *(const float*)data; break;
+	case EAXREVERB_DECAYLFRATIO: reverb.flDecayLFRatio = *(const float*)data; break;
+	case EAXREVERB_REFLECTIONS: reverb.lReflections = *(const int*)data; break;
+	case EAXREVERB_REFLECTIONSDELAY: reverb.flReflectionsDelay = *(const float*)data; break;
+	case EAXREVERB_REVERB: reverb.lReverb = *(const int*)data; break;
+	case EAXREVERB_REVERBDELAY: reverb.flReverbDelay = *(const float*)data; break;
+	case EAXREVERB_HFREFERENCE: reverb.flHFReference = *(const float*)data; break;
+	case EAXREVERB_FLAGS: reverb.ulFlags = *(const unsigned int*)data; break;
+	default:
+		// Pans, echo, modulation and the rest are accepted but make no difference
+		info("setFxProperty: FX slot %d property %d is not supported", slot, property);
+		return true;
 	}
+
+	queueReverb(batch, slot);
+	return true;
 }
 
 extern "C" {
@@ -809,7 +693,7 @@ extern "C" {
 			pCallback);
 
 		// Allocate and initialize buffer structure
-		OPEN_segaapiBuffer_t* buffer = new OPEN_segaapiBuffer_t();
+		OPEN_segaapiBuffer_t* buffer = poolAllocBuffer();
 		if (!buffer)
 		{
 			info("SEGAAPI_CreateBuffer: Failed to allocate buffer structure");
@@ -822,6 +706,7 @@ extern "C" {
 
 		// Initialize all members explicitly
 		buffer->userData = pConfig->hUserData;
+		buffer->priority = pConfig->dwPriority;
 		buffer->callback = pCallback;
 		buffer->synthesizer = (dwFlags & OPEN_HABUF_SYNTH_BUFFER) != 0;
 		buffer->loop = false;
@@ -837,27 +722,45 @@ extern "C" {
 		buffer->paused = false;
 		buffer->playWithSetup = false;
 		buffer->ownsData = false;
-		buffer->pendingRouting = false;
-		buffer->dsBuffer = nullptr;
-		buffer->lastPlayCursor = 0;
 		buffer->masterVolume = 1.0f;
 		buffer->frequency = 1.0f;
-		buffer->pan = 0;
+		buffer->playSerial = 0;
 
-		// Validate minimum buffer size
-		const unsigned int MIN_BUFFER_SIZE = blockAlign * 4;
-		if (buffer->size < MIN_BUFFER_SIZE)
+		if (dwFlags & (OPEN_HABUF_ALLOC_USER_MEM | OPEN_HABUF_USE_MAPPED_MEM))
 		{
-			info("SEGAAPI_CreateBuffer: Buffer size %d too small (min %d), adjusting", buffer->size, MIN_BUFFER_SIZE);
-			buffer->size = MIN_BUFFER_SIZE;
-		}
+			// The mixer plays game memory in place, so the size can only shrink: a
+			// partial frame at the end is dropped rather than read past the allocation
+			size_t usableSize = buffer->size - buffer->size % blockAlign;
+			if (usableSize == 0)
+			{
+				info("SEGAAPI_CreateBuffer: Buffer size %d smaller than one frame", buffer->size);
+				poolFreeBuffer(buffer);
+				return OPEN_SEGAERR_BAD_PARAM;
+			}
 
-		// Ensure buffer size is aligned to block size
-		if (buffer->size % blockAlign != 0)
+			if (usableSize != buffer->size)
+			{
+				info("SEGAAPI_CreateBuffer: Trimming buffer size from %d to %d", buffer->size, usableSize);
+				buffer->size = usableSize;
+			}
+		}
+		else
 		{
-			unsigned int alignedSize = ((buffer->size + blockAlign - 1) / blockAlign) * blockAlign;
-			info("SEGAAPI_CreateBuffer: Aligning buffer size from %d to %d", buffer->size, alignedSize);
-			buffer->size = alignedSize;
+			// Validate minimum buffer size
+			const unsigned int MIN_BUFFER_SIZE = blockAlign * 4;
+			if (buffer->size < MIN_BUFFER_SIZE)
+			{
+				info("SEGAAPI_CreateBuffer: Buffer size %d too small (min %d), adjusting", buffer->size, MIN_BUFFER_SIZE);
+				buffer->size = MIN_BUFFER_SIZE;
+			}
+
+			// Ensure buffer size is aligned to block size
+			if (buffer->size % blockAlign != 0)
+			{
+				unsigned int alignedSize = ((buffer->size + blockAlign - 1) / blockAlign) * blockAlign;
+				info("SEGAAPI_CreateBuffer: Aligning buffer size from %d to %d", buffer->size, alignedSize);
+				buffer->size = alignedSize;
+			}
 		}
 
 		// Update config to reflect actual size
@@ -871,7 +774,7 @@ extern "C" {
 			if (pConfig->mapData.hBufferHdr == nullptr)
 			{
 				info("SEGAAPI_CreateBuffer: OPEN_HABUF_ALLOC_USER_MEM flag set but hBufferHdr is NULL");
-				delete buffer;
+				poolFreeBuffer(buffer);
 				return OPEN_SEGAERR_BAD_POINTER;
 			}
 			buffer->data = (uint8_t*)pConfig->mapData.hBufferHdr;
@@ -882,7 +785,7 @@ extern "C" {
 			if (pConfig->mapData.hBufferHdr == nullptr)
 			{
 				info("SEGAAPI_CreateBuffer: OPEN_HABUF_USE_MAPPED_MEM flag set but hBufferHdr is NULL");
-				delete buffer;
+				poolFreeBuffer(buffer);
 				return OPEN_SEGAERR_BAD_POINTER;
 			}
 			buffer->data = (uint8_t*)pConfig->mapData.hBufferHdr;
@@ -890,15 +793,15 @@ extern "C" {
 		}
 		else
 		{
-			// Allocate the FULL buffer in system memory
-			buffer->data = (uint8_t*)malloc(buffer->size);
+			// Allocate the FULL buffer from the sample pool, reading as silence. 8-bit
+			// PCM is unsigned, so its silence sits at 0x80.
+			buffer->data = poolAllocSamples(buffer->size, pConfig->dwSampleFormat == OPEN_HASF_SIGNED_16PCM ? 0x00 : 0x80);
 			if (!buffer->data)
 			{
 				info("SEGAAPI_CreateBuffer: Failed to allocate %d bytes for audio data", buffer->size);
-				delete buffer;
+				poolFreeBuffer(buffer);
 				return OPEN_SEGAERR_FAIL;
 			}
-			memset(buffer->data, 0, buffer->size); // Initialize to silence
 			buffer->ownsData = true;
 		}
 
@@ -906,78 +809,47 @@ extern "C" {
 		pConfig->mapData.hBufferHdr = buffer->data;
 		pConfig->mapData.dwOffset = 0;
 
-		// Determine DirectSound buffer size (cap for hardware, but track full size in software)
-		const unsigned int MAX_DSOUND_BUFFER = 8 * 1024 * 1024; // 8 MB safe limit
-		unsigned int dsBufferSize = buffer->size;
+		// Setup WAVEFORMATEX structure, the mixer reads samples straight from data using it
+		buffer->format.wFormatTag = WAVE_FORMAT_PCM;
+		buffer->format.nChannels = (WORD)pConfig->byNumChans;
+		buffer->format.nSamplesPerSec = pConfig->dwSampleRate;
+		buffer->format.wBitsPerSample = (WORD)sampleBits;
+		buffer->format.nBlockAlign = (WORD)blockAlign;
+		buffer->format.nAvgBytesPerSec = pConfig->dwSampleRate * blockAlign;
+		buffer->format.cbSize = 0;
 
-		if (dsBufferSize > MAX_DSOUND_BUFFER)
-		{
-			info("SEGAAPI_CreateBuffer: Large buffer detected (%d bytes). Using streaming approach with %d byte DirectSound buffer.",
-				buffer->size, MAX_DSOUND_BUFFER);
-			dsBufferSize = MAX_DSOUND_BUFFER;
+		// Initialize buffer state, the mixer builds the gains before first mixing it
+		resetBuffer(buffer);
+		initVoice(buffer);
 
-			// Ensure DirectSound buffer is aligned
-			if (dsBufferSize % blockAlign != 0)
-			{
-				dsBufferSize = (dsBufferSize / blockAlign) * blockAlign;
-			}
+		void* handle;
+		{
+			std::lock_guard<std::mutex> lock(g_buffersMutex);
+			freeRetiredBuffers();
+			handle = g_buffers.add(buffer);
 		}
 
-		// Setup WAVEFORMATEX structure
-		buffer->dsFormat.wFormatTag = WAVE_FORMAT_PCM;
-		buffer->dsFormat.nChannels = (WORD)pConfig->byNumChans;
-		buffer->dsFormat.nSamplesPerSec = pConfig->dwSampleRate;
-		buffer->dsFormat.wBitsPerSample = (WORD)sampleBits;
-		buffer->dsFormat.nBlockAlign = (WORD)blockAlign;
-		buffer->dsFormat.nAvgBytesPerSec = pConfig->dwSampleRate * blockAlign;
-		buffer->dsFormat.cbSize = 0;
-
-		// Create DirectSound buffer with the safe size
-		DSBUFFERDESC dsbd;
-		ZeroMemory(&dsbd, sizeof(DSBUFFERDESC));
-		dsbd.dwSize = sizeof(DSBUFFERDESC);
-		dsbd.dwFlags = DSBCAPS_CTRLVOLUME | DSBCAPS_CTRLFREQUENCY | DSBCAPS_CTRLPAN |
-			DSBCAPS_GLOBALFOCUS | DSBCAPS_GETCURRENTPOSITION2;
-		dsbd.dwBufferBytes = dsBufferSize;  // Use the capped size for DirectSound
-		dsbd.lpwfxFormat = &buffer->dsFormat;
-
-		info("SEGAAPI_CreateBuffer: Creating DirectSound buffer - Size=%d (logical=%d), Rate=%d, Bits=%d, Channels=%d, BlockAlign=%d",
-			dsBufferSize, buffer->size, pConfig->dwSampleRate, sampleBits, pConfig->byNumChans, blockAlign);
-
-		IDirectSoundBuffer* tempBuffer = nullptr;
-		HRESULT hr = g_dsound->CreateSoundBuffer(&dsbd, &tempBuffer, NULL);
-		if (FAILED(hr))
+		if (handle == nullptr)
 		{
-			info("SEGAAPI_CreateBuffer: Failed to create DirectSound buffer: 0x%08x (size=%d, rate=%d, channels=%d, bits=%d)",
-				hr, dsBufferSize, pConfig->dwSampleRate, pConfig->byNumChans, sampleBits);
-
-			if (buffer->ownsData && buffer->data)
-			{
-				free(buffer->data);
-			}
-			delete buffer;
+			info("SEGAAPI_CreateBuffer: Out of handles");
+			freeBuffer(buffer);
 			return OPEN_SEGAERR_FAIL;
 		}
 
-		buffer->dsBuffer = tempBuffer;
-		info("SEGAAPI_CreateBuffer: DirectSound buffer created successfully");
-
-		// Initialize buffer state
-		resetBuffer(buffer);
-
-		// Add to global buffer list
-		g_allBuffers.push_back(buffer);
+		// Handed to the callback, which can only fire once the game has the handle
+		buffer->voice.handle = handle;
 
 		// Return handle
-		*phHandle = buffer;
-		info("SEGAAPI_CreateBuffer: Buffer created successfully, hHandle: %08X", buffer);
+		*phHandle = handle;
+		info("SEGAAPI_CreateBuffer: Buffer created successfully, hHandle: %08X", handle);
 
 		return OPEN_SEGA_SUCCESS;
 	}
 
 	__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetUserData(void* hHandle, void* hUserData)
 	{
-		if (hHandle == NULL)
+		OPEN_segaapiBuffer_t* buffer = g_buffers.lookup(hHandle);
+		if (buffer == nullptr)
 		{
 			info("SEGAAPI_SetUserData: Handle: %08X, Status: OPEN_SEGAERR_BAD_HANDLE", hHandle);
 			return OPEN_SEGAERR_BAD_HANDLE;
@@ -985,27 +857,57 @@ extern "C" {
 
 		info("SEGAAPI_SetUserData: Handle: %08X UserData: %08X", hHandle, hUserData);
 
-		OPEN_segaapiBuffer_t* buffer = (OPEN_segaapiBuffer_t*)hHandle;
 		buffer->userData = hUserData;
 		return OPEN_SEGA_SUCCESS;
 	}
 
 	__declspec(dllexport) void* SEGAAPI_GetUserData(void* hHandle)
 	{
-		if (hHandle == NULL)
+		OPEN_segaapiBuffer_t* buffer = g_buffers.lookup(hHandle);
+		if (buffer == nullptr)
 		{
 			return nullptr;
 		}
 
 		info("SEGAAPI_GetUserData: Handle: %08X", hHandle);
 
-		OPEN_segaapiBuffer_t* buffer = (OPEN_segaapiBuffer_t*)hHandle;
 		return buffer->userData;
 	}
 
+	__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetPriority(void* hHandle, unsigned int dwPriority)
+	{
+		OPEN_segaapiBuffer_t* buffer = g_buffers.lookup(hHandle);
+		if (buffer == nullptr)
+		{
+			info("SEGAAPI_SetPriority: Handle: %08X, Status: OPEN_SEGAERR_BAD_HANDLE", hHandle);
+			return OPEN_SEGAERR_BAD_HANDLE;
+		}
+
+		info("SEGAAPI_SetPriority: Handle: %08X dwPriority: %d", hHandle, dwPriority);
+
+		// Only matters when the voice budget runs out, higher values are kept playing longer
+		buffer->priority = dwPriority;
+		submitCommand(voiceCommand(buffer, MIXER_CMD_SET_PRIORITY, 0, (int)dwPriority));
+		return OPEN_SEGA_SUCCESS;
+	}
+
+	__declspec(dllexport) unsigned int SEGAAPI_GetPriority(void* hHandle)
+	{
+		OPEN_segaapiBuffer_t* buffer = g_buffers.lookup(hHandle);
+		if (buffer == nullptr)
+		{
+			return 0;
+		}
+
+		info("SEGAAPI_GetPriority: Handle: %08X", hHandle);
+
+		return buffer->priority;
+	}
+
 	__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_UpdateBuffer(void* hHandle, unsigned int dwStartOffset, unsigned int dwLength)
 	{
-		if (hHandle == NULL)
+		OPEN_segaapiBuffer_t* buffer = g_buffers.lookup(hHandle);
+		if (buffer == nullptr)
 		{
 			info("SEGAAPI_UpdateBuffer: Handle: %08X, Status: OPEN_SEGAERR_BAD_HANDLE", hHandle);
 			return OPEN_SEGAERR_BAD_HANDLE;
@@ -1013,52 +915,85 @@ extern "C" {
 
 		info("SEGAAPI_UpdateBuffer: Handle: %08X dwStartOffset: %08X, dwLength: %08X", hHandle, dwStartOffset, dwLength);
 
-		OPEN_segaapiBuffer_t* buffer = (OPEN_segaapiBuffer_t*)hHandle;
+		if (dwStartOffset >= buffer->size)
+		{
+			info("SEGAAPI_UpdateBuffer: Start offset %08X past the end of the buffer (%08X)", dwStartOffset, buffer->size);
+			return OPEN_SEGAERR_BAD_PARAM;
+		}
 
-		// Apply any pending routing changes before updating buffers
-		if (buffer->pendingRouting)
+		// A span may wrap to the start, so it can cover the whole buffer but no more
+		if (dwLength > buffer->size)
 		{
-			info("SEGAAPI_UpdateBuffer: Applying pending routing changes");
-			updateRouting(buffer);
+			info("SEGAAPI_UpdateBuffer: Length %08X longer than the buffer (%08X)", dwLength, buffer->size);
+			return OPEN_SEGAERR_BAD_PARAM;
 		}
 
-		// Check if we have any valid routes set up before updating
-		bool hasValidRoutes = false;
-		for (int i = 0; i < 7; i++)
+		CommandBatch batch;
+		ensureDefaultRouting(buffer, batch);
+		submitBatch(batch);
+
+		// The mixer reads straight from buffer->data and picks the new samples up when it
+		// gets to them, so nothing is copied and the cost does not depend on the span. A
+		// span running past the end continues at the start, like a streaming ring, and
+		// needs no special handling either.
+		return OPEN_SEGA_SUCCESS;
+	}
+
+	__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetNotificationFrequency(void* hHandle, unsigned int dwFrameCount)
+	{
+		OPEN_segaapiBuffer_t* buffer = g_buffers.lookup(hHandle);
+		if (buffer == nullptr)
 		{
-			if (buffer->sendRoutes[i] != OPEN_HA_UNUSED_PORT &&
-				buffer->sendRoutes[i] >= 0 &&
-				buffer->sendRoutes[i] < 6)
-			{
-				hasValidRoutes = true;
-				break;
-			}
+			info("SEGAAPI_SetNotificationFrequency: Handle: %08X, Status: OPEN_SEGAERR_BAD_HANDLE", hHandle);
+			return OPEN_SEGAERR_BAD_HANDLE;
 		}
 
-		// If no valid routes, set up default stereo routing before buffer update
-		if (!hasValidRoutes)
+		info("SEGAAPI_SetNotificationFrequency: Handle: %08X dwFrameCount: %d", hHandle, dwFrameCount);
+
+		CommandBatch batch;
+		setNotificationFrequency(buffer, batch, dwFrameCount);
+		submitBatch(batch);
+		return OPEN_SEGA_SUCCESS;
+	}
+
+	__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetNotificationPoint(void* hHandle, unsigned int dwBufferOffset)
+	{
+		OPEN_segaapiBuffer_t* buffer = g_buffers.lookup(hHandle);
+		if (buffer == nullptr)
 		{
-			info("SEGAAPI_UpdateBuffer: No valid routes detected, setting up default stereo");
-			buffer->sendRoutes[0] = OPEN_HA_FRONT_LEFT_PORT;
-			buffer->sendRoutes[1] = OPEN_HA_FRONT_RIGHT_PORT;
-			buffer->sendVolumes[0] = 1.0f;
-			buffer->sendVolumes[1] = 1.0f;
-			buffer->sendChannels[0] = 0;
-			buffer->sendChannels[1] = 1;
-			buffer->pendingRouting = true;
+			info("SEGAAPI_SetNotificationPoint: Handle: %08X, Status: OPEN_SEGAERR_BAD_HANDLE", hHandle);
+			return OPEN_SEGAERR_BAD_HANDLE;
+		}
+
+		CommandBatch batch;
+		OPEN_SEGASTATUS status = setNotificationPoint(buffer, batch, dwBufferOffset);
+		submitBatch(batch);
 
-			// Actually apply the routing configuration to DirectSound
-			updateRouting(buffer);
-			info("SEGAAPI_UpdateBuffer: Default routing applied");
+		info("SEGAAPI_SetNotificationPoint: Handle: %08X dwBufferOffset: %08X, Status: %d", hHandle, dwBufferOffset, status);
+		return status;
+	}
+
+	__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_ClearNotificationPoint(void* hHandle, unsigned int dwBufferOffset)
+	{
+		OPEN_segaapiBuffer_t* buffer = g_buffers.lookup(hHandle);
+		if (buffer == nullptr)
+		{
+			info("SEGAAPI_ClearNotificationPoint: Handle: %08X, Status: OPEN_SEGAERR_BAD_HANDLE", hHandle);
+			return OPEN_SEGAERR_BAD_HANDLE;
 		}
 
-		updateBufferNew(buffer, dwStartOffset, dwLength);
-		return OPEN_SEGA_SUCCESS;
+		CommandBatch batch;
+		OPEN_SEGASTATUS status = clearNotificationPoint(buffer, batch, dwBufferOffset);
+		submitBatch(batch);
+
+		info("SEGAAPI_ClearNotificationPoint: Handle: %08X dwBufferOffset: %08X, Status: %d", hHandle, dwBufferOffset, status);
+		return status;
 	}
 
 	__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetEndOffset(void* hHandle, unsigned int dwOffset)
 	{
-		if (hHandle == NULL)
+		OPEN_segaapiBuffer_t* buffer = g_buffers.lookup(hHandle);
+		if (buffer == nullptr)
 		{
 			info("SEGAAPI_SetEndOffset: Handle: %08X, Status: OPEN_SEGAERR_BAD_HANDLE", hHandle);
 			return OPEN_SEGAERR_BAD_HANDLE;
@@ -1066,14 +1001,16 @@ extern "C" {
 
 		info("SEGAAPI_SetEndOffset: Handle: %08X dwOffset: %08X", hHandle, dwOffset);
 
-		OPEN_segaapiBuffer_t* buffer = (OPEN_segaapiBuffer_t*)hHandle;
-		buffer->endOffset = dwOffset;
+		CommandBatch batch;
+		setVoiceParam(buffer, batch, OPEN_VOICEIOCTL_SET_END_OFFSET, dwOffset);
+		submitBatch(batch);
 		return OPEN_SEGA_SUCCESS;
 	}
 
 	__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetEndLoopOffset(void* hHandle, unsigned int dwOffset)
 	{
-		if (hHandle == NULL)
+		OPEN_segaapiBuffer_t* buffer = g_buffers.lookup(hHandle);
+		if (buffer == nullptr)
 		{
 			info("SEGAAPI_SetEndLoopOffset: Handle: %08X, Status: OPEN_SEGAERR_BAD_HANDLE", hHandle);
 			return OPEN_SEGAERR_BAD_HANDLE;
@@ -1081,14 +1018,16 @@ extern "C" {
 
 		info("SEGAAPI_SetEndLoopOffset: Handle: %08X dwOffset: %08X", hHandle, dwOffset);
 
-		OPEN_segaapiBuffer_t* buffer = (OPEN_segaapiBuffer_t*)hHandle;
-		buffer->endLoop = dwOffset;
+		CommandBatch batch;
+		setVoiceParam(buffer, batch, OPEN_VOICEIOCTL_SET_END_LOOP_OFFSET, dwOffset);
+		submitBatch(batch);
 		return OPEN_SEGA_SUCCESS;
 	}
 
 	__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetStartLoopOffset(void* hHandle, unsigned int dwOffset)
 	{
-		if (hHandle == NULL)
+		OPEN_segaapiBuffer_t* buffer = g_buffers.lookup(hHandle);
+		if (buffer == nullptr)
 		{
 			info("SEGAAPI_SetStartLoopOffset: Handle: %08X, Status: OPEN_SEGAERR_BAD_HANDLE", hHandle);
 			return OPEN_SEGAERR_BAD_HANDLE;
@@ -1096,14 +1035,16 @@ extern "C" {
 
 		info("SEGAAPI_SetStartLoopOffset: Handle: %08X dwOffset: %08X", hHandle, dwOffset);
 
-		OPEN_segaapiBuffer_t* buffer = (OPEN_segaapiBuffer_t*)hHandle;
-		buffer->startLoop = dwOffset;
+		CommandBatch batch;
+		setVoiceParam(buffer, batch, OPEN_VOICEIOCTL_SET_START_LOOP_OFFSET, dwOffset);
+		submitBatch(batch);
 		return OPEN_SEGA_SUCCESS;
 	}
 
 	__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetSampleRate(void* hHandle, unsigned int dwSampleRate)
 	{
-		if (hHandle == NULL)
+		OPEN_segaapiBuffer_t* buffer = g_buffers.lookup(hHandle);
+		if (buffer == nullptr)
 		{
 			info("SEGAAPI_SetSampleRate: Handle: %08X, Status: OPEN_SEGAERR_BAD_HANDLE", hHandle);
 			return OPEN_SEGAERR_BAD_HANDLE;
@@ -1111,20 +1052,16 @@ extern "C" {
 
 		info("SEGAAPI_SetSampleRate: Handle: %08X dwSampleRate: %08X", hHandle, dwSampleRate);
 
-		OPEN_segaapiBuffer_t* buffer = (OPEN_segaapiBuffer_t*)hHandle;
 		buffer->sampleRate = dwSampleRate;
-
-		if (buffer->dsBuffer)
-		{
-			buffer->dsBuffer->SetFrequency(dwSampleRate);
-		}
+		submitCommand(voiceCommand(buffer, MIXER_CMD_SET_RATE, 0, (int)buffer->sampleRate, buffer->frequency));
 
 		return OPEN_SEGA_SUCCESS;
 	}
 
 	__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetLoopState(void* hHandle, int bDoContinuousLooping)
 	{
-		if (hHandle == NULL)
+		OPEN_segaapiBuffer_t* buffer = g_buffers.lookup(hHandle);
+		if (buffer == nullptr)
 		{
 			info("SEGAAPI_SetLoopState: Handle: %08X, Status: OPEN_SEGAERR_BAD_HANDLE", hHandle);
 			return OPEN_SEGAERR_BAD_HANDLE;
@@ -1132,15 +1069,17 @@ extern "C" {
 
 		info("SEGAAPI_SetLoopState: Handle: %08X bDoContinuousLooping: %d", hHandle, bDoContinuousLooping);
 
-		OPEN_segaapiBuffer_t* buffer = (OPEN_segaapiBuffer_t*)hHandle;
-		buffer->loop = bDoContinuousLooping;
+		CommandBatch batch;
+		setVoiceParam(buffer, batch, OPEN_VOICEIOCTL_SET_LOOP_STATE, bDoContinuousLooping);
+		submitBatch(batch);
 
 		return OPEN_SEGA_SUCCESS;
 	}
 
 	__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetPlaybackPosition(void* hHandle, unsigned int dwPlaybackPos)
 	{
-		if (hHandle == NULL)
+		OPEN_segaapiBuffer_t* buffer = g_buffers.lookup(hHandle);
+		if (buffer == nullptr)
 		{
 			info("SEGAAPI_SetPlaybackPosition: Handle: %08X, Status: OPEN_SEGAERR_BAD_HANDLE", hHandle);
 			return OPEN_SEGAERR_BAD_HANDLE;
@@ -1148,33 +1087,22 @@ extern "C" {
 
 		info("SEGAAPI_SetPlaybackPosition: Handle: %08X dwPlaybackPos: %08X", hHandle, dwPlaybackPos);
 
-		OPEN_segaapiBuffer_t* buffer = (OPEN_segaapiBuffer_t*)hHandle;
-
-		if (buffer->dsBuffer && dwPlaybackPos < buffer->size)
-		{
-			buffer->dsBuffer->SetCurrentPosition(dwPlaybackPos);
-		}
+		CommandBatch batch;
+		setVoiceParam(buffer, batch, OPEN_VOICEIOCTL_SET_PLAY_POSITION, dwPlaybackPos);
+		submitBatch(batch);
 
 		return OPEN_SEGA_SUCCESS;
 	}
 
 	__declspec(dllexport) unsigned int SEGAAPI_GetPlaybackPosition(void* hHandle)
 	{
-		if (hHandle == NULL)
+		OPEN_segaapiBuffer_t* buffer = g_buffers.lookup(hHandle);
+		if (buffer == nullptr)
 		{
 			return 0;
 		}
 
-		OPEN_segaapiBuffer_t* buffer = (OPEN_segaapiBuffer_t*)hHandle;
-
-		if (buffer->dsBuffer == NULL)
-		{
-			return 0;
-		}
-
-		DWORD playCursor = 0;
-		DWORD writeCursor = 0;
-		buffer->dsBuffer->GetCurrentPosition(&playCursor, &writeCursor);
+		unsigned int playCursor = buffer->voice.position.load(std::memory_order_relaxed) * buffer->format.nBlockAlign;
 
 		info("SEGAAPI_GetPlaybackPosition: Handle: %08X PlayCursor: %08X", hHandle, playCursor);
 
@@ -1183,7 +1111,8 @@ extern "C" {
 
 	__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_Play(void* hHandle)
 	{
-		if (hHandle == NULL)
+		OPEN_segaapiBuffer_t* buffer = g_buffers.lookup(hHandle);
+		if (buffer == nullptr)
 		{
 			info("SEGAAPI_Play: Handle: %08X, Status: OPEN_SEGAERR_BAD_HANDLE", hHandle);
 			return OPEN_SEGAERR_BAD_HANDLE;
@@ -1191,73 +1120,16 @@ extern "C" {
 
 		info("SEGAAPI_Play: Handle: %08X", hHandle);
 
-		OPEN_segaapiBuffer_t* buffer = (OPEN_segaapiBuffer_t*)hHandle;
-
-		// Check if we have any valid routes set up
-		bool hasValidRoutes = false;
-		for (int i = 0; i < 7; i++)
-		{
-			if (buffer->sendRoutes[i] != OPEN_HA_UNUSED_PORT &&
-				buffer->sendRoutes[i] >= 0 &&
-				buffer->sendRoutes[i] < 6)
-			{
-				hasValidRoutes = true;
-				break;
-			}
-		}
-
-		// If no valid routes, set up default stereo routing
-		if (!hasValidRoutes)
-		{
-			info("SEGAAPI_Play: No valid routes, setting up default stereo routing");
-			buffer->sendRoutes[0] = OPEN_HA_FRONT_LEFT_PORT;
-			buffer->sendRoutes[1] = OPEN_HA_FRONT_RIGHT_PORT;
-			buffer->sendVolumes[0] = 1.0f;
-			buffer->sendVolumes[1] = 1.0f;
-			buffer->sendChannels[0] = 0;
-			buffer->sendChannels[1] = 1;
-			buffer->pendingRouting = true;
-		}
-
-		if (buffer->dsBuffer && !buffer->loop)
-		{
-			DWORD status = 0;
-			buffer->dsBuffer->GetStatus(&status);
-			bool isCurrentlyPlaying = (status & DSBSTATUS_PLAYING) != 0;
-
-			if (isCurrentlyPlaying)
-			{
-				// Check playback position to see if sound has finished
-				DWORD playCursor = 0;
-				DWORD writeCursor = 0;
-				buffer->dsBuffer->GetCurrentPosition(&playCursor, &writeCursor);
-
-				unsigned int bytesToPlay = buffer->endOffset - buffer->startLoop;
-
-				// Only stop and restart if the sound has finished
-				if (playCursor < buffer->lastPlayCursor || playCursor >= bytesToPlay)
-				{
-					info("SEGAAPI_Play: Non-looping sound finished (cursor=%d, length=%d) - allowing restart",
-						playCursor, bytesToPlay);
-					buffer->dsBuffer->Stop();
-					buffer->dsBuffer->SetCurrentPosition(0);
-				}
-			}
-		}
-
-		updateRouting(buffer);
-		updateBufferNew(buffer, 0, 0);
-
-		buffer->playing = true;
-		buffer->paused = false;
-		buffer->lastPlayCursor = 0;
-
+		CommandBatch batch;
+		startVoice(buffer, batch);
+		submitBatch(batch);
 		return OPEN_SEGA_SUCCESS;
 	}
 
 	__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_Stop(void* hHandle)
 	{
-		if (hHandle == NULL)
+		OPEN_segaapiBuffer_t* buffer = g_buffers.lookup(hHandle);
+		if (buffer == nullptr)
 		{
 			info("SEGAAPI_Stop: Handle: %08X, Status: OPEN_SEGAERR_BAD_HANDLE", hHandle);
 			return OPEN_SEGAERR_BAD_HANDLE;
@@ -1265,94 +1137,35 @@ extern "C" {
 
 		info("SEGAAPI_Stop: Handle: %08X", hHandle);
 
-		OPEN_segaapiBuffer_t* buffer = (OPEN_segaapiBuffer_t*)hHandle;
 		buffer->playing = false;
 		buffer->paused = false;
-
-		if (buffer->dsBuffer)
-		{
-			CHECK_HR(buffer->dsBuffer->Stop());
-			buffer->dsBuffer->SetCurrentPosition(0);
-		}
+		submitCommand(voiceCommand(buffer, MIXER_CMD_STOP));
 
 		return OPEN_SEGA_SUCCESS;
 	}
 
 	__declspec(dllexport) OPEN_HAWOSTATUS SEGAAPI_GetPlaybackStatus(void* hHandle)
 	{
-		if (hHandle == NULL)
+		OPEN_segaapiBuffer_t* buffer = g_buffers.lookup(hHandle);
+		if (buffer == nullptr)
 		{
 			info("SEGAAPI_GetPlaybackStatus: Handle: %08X, Status: OPEN_HAWOSTATUS_INVALID", hHandle);
 			return OPEN_HAWOSTATUS_INVALID;
 		}
 
-		OPEN_segaapiBuffer_t* buffer = (OPEN_segaapiBuffer_t*)hHandle;
-
 		if (buffer->paused)
 		{
 			info("SEGAAPI_GetPlaybackStatus: Handle: %08X, Status: OPEN_HAWOSTATUS_PAUSE", hHandle);
 			return OPEN_HAWOSTATUS_PAUSE;
 		}
 
-		if (buffer->dsBuffer)
+		// The mixer echoes the serial of the play it was running when the voice ends,
+		// so an end from before the latest play is not mistaken for this one
+		if (buffer->playing && buffer->voice.finishedSerial.load(std::memory_order_acquire) == buffer->playSerial)
 		{
-			DWORD status = 0;
-			buffer->dsBuffer->GetStatus(&status);
-			bool isHardwarePlaying = (status & DSBSTATUS_PLAYING) != 0;
-
-			// For non-looping sounds, check if playback position indicates completion
-			if (!buffer->loop && buffer->playing && isHardwarePlaying)
-			{
-				DWORD playCursor = 0;
-				DWORD writeCursor = 0;
-				buffer->dsBuffer->GetCurrentPosition(&playCursor, &writeCursor);
-
-				// Calculate expected end position based on endOffset
-				unsigned int bytesToPlay = buffer->endOffset - buffer->startLoop;
-
-				// If we've played past the end of the audio data, the sound is done
-				// Check if cursor has wrapped around or reached the end
-				if (playCursor < buffer->lastPlayCursor || playCursor >= bytesToPlay)
-				{
-					info("SEGAAPI_GetPlaybackStatus: Non-looping sound reached end (cursor=%d, length=%d)",
-						playCursor, bytesToPlay);
-
-					// Stop the buffer explicitly
-					buffer->dsBuffer->Stop();
-					buffer->dsBuffer->SetCurrentPosition(0);
-					isHardwarePlaying = false;
-				}
-
-				buffer->lastPlayCursor = playCursor;
-			}
-
-			if (!isHardwarePlaying && buffer->playing)
-			{
-				info("SEGAAPI_GetPlaybackStatus: Sound finished");
-
-				// Clear playing flag
-				buffer->playing = false;
-
-				// Process deferred calls
-				std::function<void()> fn;
-				while (buffer->defers.try_pop(fn))
-				{
-					fn();
-				}
-
-				// Call the application callback if registered
-				if (buffer->callback)
-				{
-					info("SEGAAPI_GetPlaybackStatus: Calling application callback");
-					buffer->callback(hHandle, OPEN_HAWOS_NOTIFY);
-				}
-			}
-
-			if (!isHardwarePlaying)
-			{
-				info("SEGAAPI_GetPlaybackStatus: Handle: %08X, Status: OPEN_HAWOSTATUS_STOP", hHandle);
-				return OPEN_HAWOSTATUS_STOP;
-			}
+			// The callback already went out when the mixer got there
+			info("SEGAAPI_GetPlaybackStatus: Sound finished");
+			buffer->playing = false;
 		}
 
 		if (buffer->playing)
@@ -1369,7 +1182,8 @@ extern "C" {
 
 	__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetReleaseState(void* hHandle, int bSet)
 	{
-		if (hHandle == NULL)
+		OPEN_segaapiBuffer_t* buffer = g_buffers.lookup(hHandle);
+		if (buffer == nullptr)
 		{
 			info("SEGAAPI_SetReleaseState: Handle: %08X, Status: OPEN_SEGAERR_BAD_HANDLE", hHandle);
 			return OPEN_SEGAERR_BAD_HANDLE;
@@ -1377,13 +1191,16 @@ extern "C" {
 
 		info("SEGAAPI_SetReleaseState: Handle: %08X bSet: %08X", hHandle, bSet);
 
-		OPEN_segaapiBuffer_t* buffer = (OPEN_segaapiBuffer_t*)hHandle;
-
-		if (bSet && buffer->dsBuffer)
+		// Synth voices play out their release and report the end when it is over,
+		// anything else has no envelope and stops right away
+		if (bSet && buffer->synthesizer)
+		{
+			submitCommand(voiceCommand(buffer, MIXER_CMD_RELEASE));
+		}
+		else if (bSet)
 		{
 			buffer->playing = false;
-			buffer->dsBuffer->Stop();
-			buffer->dsBuffer->SetCurrentPosition(0);
+			submitCommand(voiceCommand(buffer, MIXER_CMD_STOP));
 		}
 
 		return OPEN_SEGA_SUCCESS;
@@ -1391,7 +1208,11 @@ extern "C" {
 
 	__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_DestroyBuffer(void* hHandle)
 	{
-		if (hHandle == NULL)
+		std::lock_guard<std::mutex> lock(g_buffersMutex);
+
+		// From here on the handle is stale, a second destroy gets BAD_HANDLE
+		OPEN_segaapiBuffer_t* buffer = g_buffers.remove(hHandle);
+		if (buffer == nullptr)
 		{
 			info("SEGAAPI_DestroyBuffer: Handle: %08X, Status: OPEN_SEGAERR_BAD_HANDLE", hHandle);
 			return OPEN_SEGAERR_BAD_HANDLE;
@@ -1399,41 +1220,98 @@ extern "C" {
 
 		info("SEGAAPI_DestroyBuffer: Handle: %08X", hHandle);
 
-		OPEN_segaapiBuffer_t* buffer = (OPEN_segaapiBuffer_t*)hHandle;
+		// The mixer may be in the middle of a period with it, so it is only freed
+		// after the mixer has taken it off its list. When the mixer is idle, as it is
+		// between renders in offline mode, that happens right here.
+		submitCommand(voiceCommand(buffer, MIXER_CMD_RETIRE));
+		mixerTryFlush();
+		g_retiredBuffers.push_back(buffer);
+		freeRetiredBuffers();
+
+		return OPEN_SEGA_SUCCESS;
+	}
+
+	__declspec(dllexport) int SEGAAPI_SetGlobalEAXProperty(GUID* guid, unsigned long ulProperty, void* pData, unsigned long ulDataSize)
+	{
+		info("SEGAAPI_SetGlobalEAXProperty: ulProperty: %08X ulDataSize: %d", ulProperty, ulDataSize);
 
-		g_allBuffers.erase(std::remove(g_allBuffers.begin(), g_allBuffers.end(), buffer), g_allBuffers.end());
+		if (guid == NULL)
+			return FALSE;
 
-		if (buffer->dsBuffer)
+		// Deferred properties are applied right away, committing them has nothing left to do
+		unsigned int property = (unsigned int)(ulProperty & ~EAX_DEFERRED);
+
+		if (memcmp(guid, &EAXPROPERTYID_EAX40_SEGA_Custom, sizeof(GUID)) == 0)
 		{
-			buffer->dsBuffer->Stop();
-			buffer->dsBuffer->Release();
+			// Where the FX slots return their stereo output to
+			if (property != EAXOPENSEGA_STEREO_RETURN_FX2 && property != EAXOPENSEGA_STEREO_RETURN_FX3)
+				return FALSE;
+
+			MixerCommand command = {};
+			command.type = MIXER_CMD_SET_FX_RETURN;
+			command.param = property == EAXOPENSEGA_STEREO_RETURN_FX3 ? OPEN_HA_REAR_LEFT_PORT : OPEN_HA_FRONT_LEFT_PORT;
+			submitCommand(command);
+			return TRUE;
 		}
 
-		if (buffer->ownsData && buffer->data)
+		int slot = fxSlotIndex(guid);
+		if (slot < 0)
 		{
-			free(buffer->data);
+			// Everything is fine
+			info("SEGAAPI_SetGlobalEAXProperty: Unknown property set");
+			return TRUE;
 		}
 
-		delete buffer;
-		return OPEN_SEGA_SUCCESS;
-	}
-
-	__declspec(dllexport) int SEGAAPI_SetGlobalEAXProperty(GUID* guid, unsigned long ulProperty, void* pData, unsigned long ulDataSize)
-	{
-		info("SEGAAPI_SetGlobalEAXProperty:");
+		CommandBatch batch;
+		bool valid = setFxProperty(batch, slot, property, pData, ulDataSize);
+		submitBatch(batch);
 
-		// Everything is fine
-		return TRUE;
+		return valid ? TRUE : FALSE;
 	}
 
 	__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_Init(void)
 	{
 		info("SEGAAPI_Init");
 
-		CoInitialize(nullptr);
+		// A second init would restart the mixer and the output under the running ones
+		if (g_output != nullptr)
+		{
+			info("SEGAAPI_Init: Already initialized");
+			return OPEN_SEGA_SUCCESS;
+		}
+
+		poolInit();
+		mixerInit(MIXER_SAMPLE_RATE, getOutputChannels());
+
+		// The mixer starts every FX slot out with a generic reverb at full volume
+		for (int slot = 0; slot < MIXER_FX_SLOTS; slot++)
+		{
+			g_fxSlots[slot].guidLoadEffect = EAX_REVERB_EFFECT;
+			g_fxSlots[slot].lVolume = 0;
+			g_fxSlots[slot].lLock = 0;
+			g_fxSlots[slot].ulFlags = 0;
+			g_fxReverbs[slot] = g_genericReverb;
+		}
 
-		CHECK_HR(DirectSoundCreate8(NULL, &g_dsound, NULL));
-		CHECK_HR(g_dsound->SetCooperativeLevel(GetDesktopWindow(), DSSCL_PRIORITY));
+		OutputFormat format;
+		format.sampleRate = MIXER_SAMPLE_RATE;
+		format.channels = mixerChannels();
+		format.periodFrames = MIXER_PERIOD_FRAMES;
+
+		g_output = createOutputBackend();
+		if (!g_output->open(format, mixerRender))
+		{
+			// Keep the game running without audio rather than failing init
+			info("SEGAAPI_Init: Output %s failed to open, falling back to null output", g_output->name());
+			delete g_output;
+			g_output = createNullBackend();
+			g_output->open(format, mixerRender);
+		}
+
+		// A host rendering by itself gets a period's callbacks before its render returns
+		callbackStart(!g_output->pullDriven());
+
+		info("SEGAAPI_Init: Output %s, latency %d frames", g_output->name(), g_output->latency());
 
 		return OPEN_SEGA_SUCCESS;
 	}
@@ -1442,12 +1320,25 @@ extern "C" {
 	{
 		info("SEGAAPI_Exit");
 
-		if (g_dsound)
+		if (g_output)
 		{
-			g_dsound->Release();
-			g_dsound = nullptr;
+			g_output->close();
+			delete g_output;
+			g_output = nullptr;
 		}
 
+		// Nothing mixes anymore, apply what is left so destroyed buffers can go
+		mixerFlush();
+		callbackStop();
+
+		std::lock_guard<std::mutex> lock(g_buffersMutex);
+		freeRetiredBuffers();
+
+		PoolStats stats;
+		poolGetStats(&stats);
+		info("SEGAAPI_Exit: Buffers %d of %d pooled, sample blocks %d in use (%d bytes) and %d free in %d bytes of chunks, %d large buffers (%d bytes)",
+			stats.buffersInUse, stats.buffersPooled, stats.blocksInUse, stats.blockBytesInUse, stats.blocksFree, stats.chunkBytes, stats.largeInUse, stats.largeBytesInUse);
+
 		return OPEN_SEGA_SUCCESS;
 	}
 
@@ -1468,61 +1359,24 @@ extern "C" {
 		}
 
 		float volume = dwVolume / (float)0xFFFFFFFF;
-		g_masterVolumes[dwPhysIO] = volume;
-
-		info("SEGAAPI_SetIOVolume: Set master volume for port %d to %f", dwPhysIO, volume);
 
-		for (auto buffer : g_allBuffers)
-		{
-			bool affectsThisBuffer = false;
-			for (int i = 0; i < 7; i++)
-			{
-				if (buffer->sendRoutes[i] != OPEN_HA_UNUSED_PORT)
-				{
-					int physPort = -1;
-					switch (buffer->sendRoutes[i])
-					{
-					case OPEN_HA_FRONT_LEFT_PORT:
-						physPort = OPEN_HA_OUT_FRONT_LEFT;
-						break;
-					case OPEN_HA_FRONT_RIGHT_PORT:
-						physPort = OPEN_HA_OUT_FRONT_RIGHT;
-						break;
-					case OPEN_HA_FRONT_CENTER_PORT:
-						physPort = OPEN_HA_OUT_FRONT_CENTER;
-						break;
-					case OPEN_HA_LFE_PORT:
-						physPort = OPEN_HA_OUT_LFE_PORT;
-						break;
-					case OPEN_HA_REAR_LEFT_PORT:
-						physPort = OPEN_HA_OUT_REAR_LEFT;
-						break;
-					case OPEN_HA_REAR_RIGHT_PORT:
-						physPort = OPEN_HA_OUT_REAR_RIGHT;
-						break;
-					}
-
-					if (physPort == dwPhysIO)
-					{
-						affectsThisBuffer = true;
-						break;
-					}
-				}
-			}
+		// Voices routed to this port pick up the new volume on the next period, ports
+		// past the six routable ones have nothing routed to them
+		MixerCommand command = {};
+		command.type = MIXER_CMD_SET_IO_VOLUME;
+		command.index = dwPhysIO;
+		command.value = volume;
+		submitCommand(command);
 
-			if (affectsThisBuffer)
-			{
-				buffer->pendingRouting = true;
-				updateRouting(buffer);
-			}
-		}
+		info("SEGAAPI_SetIOVolume: Set master volume for port %d to %f", dwPhysIO, volume);
 
 		return OPEN_SEGA_SUCCESS;
 	}
 
 	__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetSendRouting(void* hHandle, unsigned int dwChannel, unsigned int dwSend, OPEN_HAROUTING dwDest)
 	{
-		if (hHandle == NULL)
+		OPEN_segaapiBuffer_t* buffer = g_buffers.lookup(hHandle);
+		if (buffer == nullptr)
 		{
 			info("SEGAAPI_SetSendRouting: Handle: %08X, Status: OPEN_SEGAERR_BAD_HANDLE", hHandle);
 			return OPEN_SEGAERR_BAD_HANDLE;
@@ -1542,23 +1396,17 @@ extern "C" {
 			return OPEN_SEGAERR_BAD_PARAM;
 		}
 
-		OPEN_segaapiBuffer_t* buffer = (OPEN_segaapiBuffer_t*)hHandle;
 		buffer->sendRoutes[dwSend] = dwDest;
 		buffer->sendChannels[dwSend] = dwChannel;
-		buffer->pendingRouting = true;
-
-		if (buffer->dsBuffer)
-		{
-			info("SEGAAPI_SetSendLevel: Applying routing immediately");
-			updateRouting(buffer);
-		}
+		submitCommand(sendCommand(buffer, dwSend));
 
 		return OPEN_SEGA_SUCCESS;
 	}
 
 	__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetSendLevel(void* hHandle, unsigned int dwChannel, unsigned int dwSend, unsigned int dwLevel)
 	{
-		if (hHandle == NULL)
+		OPEN_segaapiBuffer_t* buffer = g_buffers.lookup(hHandle);
+		if (buffer == nullptr)
 		{
 			info("SEGAAPI_SetSendLevel: Handle: %08X, Status: OPEN_SEGAERR_BAD_HANDLE", hHandle);
 			return OPEN_SEGAERR_BAD_HANDLE;
@@ -1578,23 +1426,17 @@ extern "C" {
 			return OPEN_SEGAERR_BAD_PARAM;
 		}
 
-		OPEN_segaapiBuffer_t* buffer = (OPEN_segaapiBuffer_t*)hHandle;
-
 		buffer->sendVolumes[dwSend] = dwLevel / (float)0xFFFFFFFF;
 		buffer->sendChannels[dwSend] = dwChannel;
-		buffer->pendingRouting = true;
-
-		if (buffer->dsBuffer)
-		{
-			updateRouting(buffer);
-		}
+		submitCommand(sendCommand(buffer, dwSend));
 
 		return OPEN_SEGA_SUCCESS;
 	}
 
 	__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetSynthParam(void* hHandle, OPEN_HASYNTHPARAMSEXT param, int lPARWValue)
 	{
-		if (hHandle == NULL)
+		OPEN_segaapiBuffer_t* buffer = g_buffers.lookup(hHandle);
+		if (buffer == nullptr)
 		{
 			info("SEGAAPI_SetSynthParam: Handle: %08X, Status: OPEN_SEGAERR_BAD_HANDLE", hHandle);
 			return OPEN_SEGAERR_BAD_HANDLE;
@@ -1608,43 +1450,15 @@ extern "C" {
 			return OPEN_SEGAERR_BAD_PARAM;
 		}
 
-		OPEN_segaapiBuffer_t* buffer = (OPEN_segaapiBuffer_t*)hHandle;
-
-		if (param == OPEN_HAVP_ATTENUATION)
-		{
-			long attenuationDB = -(long)(lPARWValue * 10);
-
-			// Store as linear gain for routing calculations
-			buffer->masterVolume = powf(10.0f, attenuationDB / 2000.0f);
-			buffer->pendingRouting = true;
-			updateRouting(buffer);
-
-			info("SEGAAPI_SetSynthParam: OPEN_HAVP_ATTENUATION dB: %d (-%f dB), gain: %f",
-				lPARWValue, lPARWValue / 10.0f, buffer->masterVolume);
-		}
-		else if (param == OPEN_HAVP_PITCH)
-		{
-			float semiTones = lPARWValue / 100.0f;
-			float freqRatio = powf(2.0f, semiTones / 12.0f);
-
-			buffer->frequency = freqRatio;
-
-			if (buffer->dsBuffer)
-			{
-				DWORD newFreq = (DWORD)(buffer->sampleRate * freqRatio);
-				newFreq = max(DSBFREQUENCY_MIN, min(DSBFREQUENCY_MAX, newFreq));
-				buffer->dsBuffer->SetFrequency(newFreq);
-			}
-
-			info("SEGAAPI_SetSynthParam: OPEN_HAVP_PITCH hHandle: %08X semitones: %f freqRatio: %f", hHandle, semiTones, freqRatio);
-		}
-
+		CommandBatch batch;
+		setSynthParam(buffer, batch, param, lPARWValue);
+		submitBatch(batch);
 		return OPEN_SEGA_SUCCESS;
 	}
 
 	__declspec(dllexport) int SEGAAPI_GetSynthParam(void* hHandle, OPEN_HASYNTHPARAMSEXT param)
 	{
-		if (hHandle == NULL)
+		if (g_buffers.lookup(hHandle) == nullptr)
 		{
 			info("SEGAAPI_GetSynthParam: Handle: %08X, Status: OPEN_SEGAERR_BAD_HANDLE", hHandle);
 			return OPEN_SEGAERR_BAD_HANDLE;
@@ -1657,7 +1471,7 @@ extern "C" {
 
 	__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetSynthParamMultiple(void* hHandle, unsigned int dwNumParams, OPEN_SynthParamSet* pSynthParams)
 	{
-		if (hHandle == NULL)
+		if (g_buffers.lookup(hHandle) == nullptr)
 		{
 			info("SEGAAPI_SetSynthParamMultiple: Handle: %08X, Status: OPEN_SEGAERR_BAD_HANDLE", hHandle);
 			return OPEN_SEGAERR_BAD_HANDLE;
@@ -1681,7 +1495,8 @@ extern "C" {
 
 	__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_SetChannelVolume(void* hHandle, unsigned int dwChannel, unsigned int dwVolume)
 	{
-		if (hHandle == NULL)
+		OPEN_segaapiBuffer_t* buffer = g_buffers.lookup(hHandle);
+		if (buffer == nullptr)
 		{
 			info("SEGAAPI_SetChannelVolume: Handle: %08X, Status: OPEN_SEGAERR_BAD_HANDLE", hHandle);
 			return OPEN_SEGAERR_BAD_HANDLE;
@@ -1689,8 +1504,6 @@ extern "C" {
 
 		info("SEGAAPI_SetChannelVolume: hHandle: %08X dwChannel: %08X dwVolume: %08X", hHandle, dwChannel, dwVolume);
 
-		OPEN_segaapiBuffer_t* buffer = (OPEN_segaapiBuffer_t*)hHandle;
-
 		if (dwChannel >= 6)
 		{
 			info("SEGAAPI_SetChannelVolume: Invalid channel %d", dwChannel);
@@ -1698,15 +1511,14 @@ extern "C" {
 		}
 
 		buffer->channelVolumes[dwChannel] = dwVolume / (float)0xFFFFFFFF;
-		buffer->pendingRouting = true;
-
-		updateRouting(buffer);
+		submitCommand(voiceCommand(buffer, MIXER_CMD_SET_CHANNEL_VOLUME, dwChannel, 0, buffer->channelVolumes[dwChannel]));
 		return OPEN_SEGA_SUCCESS;
 	}
 
 	__declspec(dllexport) unsigned int SEGAAPI_GetChannelVolume(void* hHandle, unsigned int dwChannel)
 	{
-		if (hHandle == NULL)
+		OPEN_segaapiBuffer_t* buffer = g_buffers.lookup(hHandle);
+		if (buffer == nullptr)
 		{
 			info("SEGAAPI_GetChannelVolume: Handle: %08X, Status: OPEN_SEGAERR_BAD_HANDLE", hHandle);
 			return 0;
@@ -1714,8 +1526,6 @@ extern "C" {
 
 		info("SEGAAPI_GetChannelVolume: hHandle: %08X dwChannel: %08X", hHandle, dwChannel);
 
-		OPEN_segaapiBuffer_t* buffer = (OPEN_segaapiBuffer_t*)hHandle;
-
 		if (dwChannel >= 6)
 		{
 			info("SEGAAPI_GetChannelVolume: Invalid channel %d", dwChannel);
@@ -1727,7 +1537,8 @@ extern "C" {
 
 	__declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_Pause(void* hHandle)
 	{
-		if (hHandle == NULL)
+		OPEN_segaapiBuffer_t* buffer = g_buffers.lookup(hHandle);
+		if (buffer == nullptr)
 		{
 			info("SEGAAPI_Pause: Handle: %08X, Status: OPEN_SEGAERR_BAD_HANDLE", hHandle);
 			return OPEN_SEGAERR_BAD_HANDLE;
@@ -1735,15 +1546,9 @@ extern "C" {
 
 		info("SEGAAPI_Pause: hHandle: %08X", hHandle);
 
-		OPEN_segaapiBuffer_t* buffer = (OPEN_segaapiBuffer_t*)hHandle;
-
 		buffer->playing = false;
 		buffer->paused = true;
-
-		if (buffer->dsBuffer)
-		{
-			CHECK_HR(buffer->dsBuffer->Stop());
-		}
+		submitCommand(voiceCommand(buffer, MIXER_CMD_PAUSE));
 
 		return OPEN_SEGA_SUCCESS;
 	}
@@ -1756,7 +1561,8 @@ extern "C" {
 		unsigned int dwNumSynthParams, OPEN_SynthParamSet* pSynthParams
 	)
 	{
-		if (hHandle == NULL)
+		OPEN_segaapiBuffer_t* buffer = g_buffers.lookup(hHandle);
+		if (buffer == nullptr)
 		{
 			info("SEGAAPI_PlayWithSetup: Handle: %08X, Status: OPEN_SEGAERR_BAD_HANDLE", hHandle);
 			return OPEN_SEGAERR_BAD_HANDLE;
@@ -1765,65 +1571,98 @@ extern "C" {
 		info("SEGAAPI_PlayWithSetup: hHandle: %08X dwNumSendRouteParams: %d pSendRouteParams: %08X dwNumSendLevelParams: %d pSendLevelParams: %08X dwNumVoiceParams: %d pVoiceParams: %08X dwNumSynthParams: %d pSynthParams: %08X", hHandle, dwNumSendRouteParams, pSendRouteParams, dwNumSendLevelParams, pSendLevelParams, dwNumVoiceParams, pVoiceParams, dwNumSynthParams, pSynthParams);
 		info("dwNumSynthParams: %d", dwNumSynthParams);
 
-		OPEN_segaapiBuffer_t* buffer = (OPEN_segaapiBuffer_t*)hHandle;
-		buffer->playWithSetup = true;
+		if ((dwNumSendRouteParams > 0 && pSendRouteParams == NULL) ||
+			(dwNumSendLevelParams > 0 && pSendLevelParams == NULL) ||
+			(dwNumVoiceParams > 0 && pVoiceParams == NULL) ||
+			(dwNumSynthParams > 0 && pSynthParams == NULL))
+		{
+			info("SEGAAPI_PlayWithSetup: Null parameter array");
+			return OPEN_SEGAERR_BAD_POINTER;
+		}
 
+		// Check everything before touching the voice, a bad entry leaves it as it was
 		for (unsigned int i = 0; i < dwNumSendRouteParams; i++)
 		{
-			SEGAAPI_SetSendRouting(hHandle, pSendRouteParams[i].dwChannel, pSendRouteParams[i].dwSend, pSendRouteParams[i].dwDest);
+			if (pSendRouteParams[i].dwSend >= 7 || pSendRouteParams[i].dwChannel >= 6)
+			{
+				info("SEGAAPI_PlayWithSetup: Invalid send route %d (channel %d, send %d)", i, pSendRouteParams[i].dwChannel, pSendRouteParams[i].dwSend);
+				return OPEN_SEGAERR_BAD_PARAM;
+			}
 		}
 
 		for (unsigned int i = 0; i < dwNumSendLevelParams; i++)
 		{
-			SEGAAPI_SetSendLevel(hHandle, pSendLevelParams[i].dwChannel, pSendLevelParams[i].dwSend, pSendLevelParams[i].dwLevel);
+			if (pSendLevelParams[i].dwSend >= 7 || pSendLevelParams[i].dwChannel >= 6)
+			{
+				info("SEGAAPI_PlayWithSetup: Invalid send level %d (channel %d, send %d)", i, pSendLevelParams[i].dwChannel, pSendLevelParams[i].dwSend);
+				return OPEN_SEGAERR_BAD_PARAM;
+			}
 		}
 
-		unsigned int loopStart = 0;
-		unsigned int loopEnd = 0;
-		unsigned int loopState = 0;
-		unsigned int endOffset = 0;
-
 		for (unsigned int i = 0; i < dwNumVoiceParams; i++)
 		{
-			switch (pVoiceParams[i].VoiceIoctl)
+			if (pVoiceParams[i].VoiceIoctl < OPEN_VOICEIOCTL_SET_START_LOOP_OFFSET ||
+				pVoiceParams[i].VoiceIoctl > OPEN_VOICEIOCTL_SET_NOTIFICATION_FREQUENCY)
 			{
-			case OPEN_VOICEIOCTL_SET_START_LOOP_OFFSET:
-				SEGAAPI_SetStartLoopOffset(hHandle, pVoiceParams[i].dwParam1);
-				loopStart = pVoiceParams[i].dwParam1;
-				break;
-			case OPEN_VOICEIOCTL_SET_END_LOOP_OFFSET:
-				SEGAAPI_SetEndLoopOffset(hHandle, pVoiceParams[i].dwParam1);
-				loopEnd = pVoiceParams[i].dwParam1;
-				break;
-			case OPEN_VOICEIOCTL_SET_END_OFFSET:
-				SEGAAPI_SetEndOffset(hHandle, pVoiceParams[i].dwParam1);
-				endOffset = pVoiceParams[i].dwParam1;
-				break;
-			case OPEN_VOICEIOCTL_SET_LOOP_STATE:
-				SEGAAPI_SetLoopState(hHandle, pVoiceParams[i].dwParam1);
-				loopState = pVoiceParams[i].dwParam1;
-				break;
-			case OPEN_VOICEIOCTL_SET_NOTIFICATION_POINT:
-				info("Unimplemented! OPEN_VOICEIOCTL_SET_NOTIFICATION_POINT");
-				break;
-			case OPEN_VOICEIOCTL_CLEAR_NOTIFICATION_POINT:
-				info("Unimplemented! OPEN_VOICEIOCTL_CLEAR_NOTIFICATION_POINT");
-				break;
-			case OPEN_VOICEIOCTL_SET_NOTIFICATION_FREQUENCY:
-				info("Unimplemented! OPEN_VOICEIOCTL_SET_NOTIFICATION_FREQUENCY");
-				break;
+				info("SEGAAPI_PlayWithSetup: Invalid voice ioctl %d", pVoiceParams[i].VoiceIoctl);
+				return OPEN_SEGAERR_BAD_PARAM;
 			}
 		}
 
-		info("Loopdata: hHandle: %08X, loopStart: %08X, loopEnd: %08X, endOffset: %08X, loopState: %d, size: %d", hHandle, loopStart, loopEnd, endOffset, loopState, buffer->size);
-
 		for (unsigned int i = 0; i < dwNumSynthParams; i++)
 		{
-			SEGAAPI_SetSynthParam(hHandle, pSynthParams[i].param, pSynthParams[i].lPARWValue);
+			if (pSynthParams[i].param < 0 || pSynthParams[i].param >= 26)
+			{
+				info("SEGAAPI_PlayWithSetup: Invalid synth param %d", pSynthParams[i].param);
+				return OPEN_SEGAERR_BAD_PARAM;
+			}
 		}
 
-		SEGAAPI_Play(hHandle);
+		// Every parameter queues at most one command, starting adds the default routes
+		// and the play
+		unsigned long long commandCount = (unsigned long long)dwNumSendRouteParams + dwNumSendLevelParams + dwNumVoiceParams + dwNumSynthParams + 3;
+		if (commandCount > MIXER_COMMAND_CAPACITY)
+		{
+			info("SEGAAPI_PlayWithSetup: %llu commands do not fit the mixer's queue", commandCount);
+			return OPEN_SEGAERR_BAD_PARAM;
+		}
+
+		// Applied and started as one batch, so the mixer never sees a half set up voice
+		// and gains are built once for the whole batch
+		CommandBatch batch;
+		if (commandCount > MAX_BATCH_COMMANDS)
+			batch.large.reserve((size_t)commandCount);
+
+		buffer->playWithSetup = true;
+
+		for (unsigned int i = 0; i < dwNumSendRouteParams; i++)
+		{
+			buffer->sendRoutes[pSendRouteParams[i].dwSend] = pSendRouteParams[i].dwDest;
+			buffer->sendChannels[pSendRouteParams[i].dwSend] = pSendRouteParams[i].dwChannel;
+			queueCommand(batch, sendCommand(buffer, pSendRouteParams[i].dwSend));
+		}
+
+		for (unsigned int i = 0; i < dwNumSendLevelParams; i++)
+		{
+			buffer->sendVolumes[pSendLevelParams[i].dwSend] = pSendLevelParams[i].dwLevel / (float)0xFFFFFFFF;
+			buffer->sendChannels[pSendLevelParams[i].dwSend] = pSendLevelParams[i].dwChannel;
+			queueCommand(batch, sendCommand(buffer, pSendLevelParams[i].dwSend));
+		}
+
+		for (unsigned int i = 0; i < dwNumVoiceParams; i++)
+		{
+			setVoiceParam(buffer, batch, pVoiceParams[i].VoiceIoctl, pVoiceParams[i].dwParam1);
+		}
+
+		info("Loopdata: hHandle: %08X, loopStart: %08X, loopEnd: %08X, endOffset: %08X, loopState: %d, size: %d", hHandle, buffer->startLoop, buffer->endLoop, buffer->endOffset, buffer->loop, buffer->size);
+
+		for (unsigned int i = 0; i < dwNumSynthParams; i++)
+		{
+			setSynthParam(buffer, batch, pSynthParams[i].param, pSynthParams[i].lPARWValue);
+		}
 
+		startVoice(buffer, batch);
+		submitBatch(batch);
 		return OPEN_SEGA_SUCCESS;
 	}
 
@@ -1832,5 +1671,54 @@ extern "C" {
 		info("SEGAAPI_GetLastStatus");
 		return OPEN_SEGA_SUCCESS;
 	}
+
+	__declspec(dllexport) OPEN_SEGASTATUS OPENSEGAAPI_Render(short* pOutput, unsigned int dwFrames)
+	{
+		if (pOutput == NULL)
+		{
+			return OPEN_SEGAERR_BAD_POINTER;
+		}
+
+		if (g_output == nullptr || g_output->render(pOutput, dwFrames) != dwFrames)
+		{
+			info("OPENSEGAAPI_Render: Output is not running in offline mode");
+			return OPEN_SEGAERR_FAIL;
+		}
+
+		return OPEN_SEGA_SUCCESS;
+	}
+
+	__declspec(dllexport) OPEN_SEGASTATUS OPENSEGAAPI_GetOutputFormat(unsigned int* pdwSampleRate, unsigned int* pdwChannels)
+	{
+		if (pdwSampleRate == NULL || pdwChannels == NULL)
+		{
+			return OPEN_SEGAERR_BAD_POINTER;
+		}
+
+		*pdwSampleRate = MIXER_SAMPLE_RATE;
+		*pdwChannels = mixerChannels();
+		return OPEN_SEGA_SUCCESS;
+	}
+
+	__declspec(dllexport) OPEN_SEGASTATUS OPENSEGAAPI_GetMemoryStats(OPENSEGAAPI_MEMORYSTATS* pStats)
+	{
+		if (pStats == NULL)
+		{
+			return OPEN_SEGAERR_BAD_POINTER;
+		}
+
+		PoolStats stats;
+		poolGetStats(&stats);
+
+		pStats->dwBuffersInUse = stats.buffersInUse;
+		pStats->dwBuffersPooled = stats.buffersPooled;
+		pStats->dwSampleBlocksInUse = stats.blocksInUse;
+		pStats->dwSampleBlocksFree = stats.blocksFree;
+		pStats->dwSampleBlockBytesInUse = (unsigned int)stats.blockBytesInUse;
+		pStats->dwSampleChunkBytes = (unsigned int)stats.chunkBytes;
+		pStats->dwLargeSampleBuffers = stats.largeInUse;
+		pStats->dwLargeSampleBytes = (unsigned int)stats.largeBytesInUse;
+		return OPEN_SEGA_SUCCESS;
+	}
 }
 #pragma optimize("", on)
\ No newline at end of file
@@ -4,8 +4,9 @@
 * See LICENSE and MENTIONS in the root of the source tree for information
 * regarding licensing.
 */
+#pragma once
 
-#include <guiddef.h>
+#include "platform.h"
 
 // TODO: DOCUMENT ALL THESE ACCORDING TO ORIGINAL DOCUMENTS!!!!
 
@@ -29,6 +30,110 @@ typedef enum
 	EAXOPENSEGA_STEREO_RETURN_FX3 = 1 // rear L/R
 } EAXOPENSEGA_PROPERTY;
 
+// EAX 4.0 FX slots, the effects OPEN_HA_FXSLOT0..3_PORT send to.
+DEFINE_GUID(EAXPROPERTYID_EAX40_FXSlot0,
+	0xc4d79f1e, 0xf1ac, 0x436b, 0xa8, 0x1d, 0xa7, 0x38, 0xe7, 0x04, 0x54, 0x69);
+DEFINE_GUID(EAXPROPERTYID_EAX40_FXSlot1,
+	0x08c00e96, 0x74be, 0x4491, 0x93, 0xaa, 0xe8, 0xad, 0x35, 0xa4, 0x91, 0x17);
+DEFINE_GUID(EAXPROPERTYID_EAX40_FXSlot2,
+	0x1d433b88, 0xf0f6, 0x4637, 0x91, 0x9f, 0x60, 0xe7, 0xe0, 0x6b, 0x5e, 0xdd);
+DEFINE_GUID(EAXPROPERTYID_EAX40_FXSlot3,
+	0xefff08ea, 0xc7d8, 0x44ab, 0x93, 0xad, 0x6d, 0xbd, 0x5f, 0x91, 0x00, 0x64);
+
+// The effect an FX slot loads to reverberate
+DEFINE_GUID(EAX_REVERB_EFFECT,
+	0x0cf95c8f, 0xa3cc, 0x4849, 0xb0, 0xb6, 0x83, 0x2e, 0xcc, 0x18, 0x22, 0xdf);
+
+// Set on a property to have it applied with the next one that is not
+#define EAX_DEFERRED 0x80000000
+
+// Properties of the slot itself. Below EAXFXSLOT_NONE the property is one of the
+// loaded effect's.
+typedef enum
+{
+	EAXFXSLOT_NONE = 0x10000,
+	EAXFXSLOT_ALLPARAMETERS,
+	EAXFXSLOT_LOADEFFECT,
+	EAXFXSLOT_VOLUME,
+	EAXFXSLOT_LOCK,
+	EAXFXSLOT_FLAGS
+} EAXFXSLOT_PROPERTY;
+
+typedef struct
+{
+	GUID guidLoadEffect;
+	int lVolume;
+	int lLock;
+	unsigned int ulFlags;
+} EAXFXSLOTPROPERTIES;
+
+// Properties of the reverb effect
+typedef enum
+{
+	EAXREVERB_NONE,
+	EAXREVERB_ALLPARAMETERS,
+	EAXREVERB_ENVIRONMENT,
+	EAXREVERB_ENVIRONMENTSIZE,
+	EAXREVERB_ENVIRONMENTDIFFUSION,
+	EAXREVERB_ROOM,
+	EAXREVERB_ROOMHF,
+	EAXREVERB_ROOMLF,
+	EAXREVERB_DECAYTIME,
+	EAXREVERB_DECAYHFRATIO,
+	EAXREVERB_DECAYLFRATIO,
+	EAXREVERB_REFLECTIONS,
+	EAXREVERB_REFLECTIONSDELAY,
+	EAXREVERB_REFLECTIONSPAN,
+	EAXREVERB_REVERB,
+	EAXREVERB_REVERBDELAY,
+	EAXREVERB_REVERBPAN,
+	EAXREVERB_ECHOTIME,
+	EAXREVERB_ECHODEPTH,
+	EAXREVERB_MODULATIONTIME,
+	EAXREVERB_MODULATIONDEPTH,
+	EAXREVERB_AIRABSORPTIONHF,
+	EAXREVERB_HFREFERENCE,
+	EAXREVERB_LFREFERENCE,
+	EAXREVERB_ROOMROLLOFFFACTOR,
+	EAXREVERB_FLAGS
+} EAXREVERB_PROPERTY;
+
+typedef struct
+{
+	float x;
+	float y;
+	float z;
+} EAXVECTOR;
+
+// Levels in millibels, times in seconds
+typedef struct
+{
+	unsigned int ulEnvironment;
+	float flEnvironmentSize;
+	float flEnvironmentDiffusion;
+	int lRoom;
+	int lRoomHF;
+	int lRoomLF;
+	float flDecayTime;
+	float flDecayHFRatio;
+	float flDecayLFRatio;
+	int lReflections;
+	float flReflectionsDelay;
+	EAXVECTOR vReflectionsPan;
+	int lReverb;
+	float flReverbDelay;
+	EAXVECTOR vReverbPan;
+	float flEchoTime;
+	float flEchoDepth;
+	float flModulationTime;
+	float flModulationDepth;
+	float flAirAbsorptionHF;
+	float flHFReference;
+	float flLFReference;
+	float flRoomRolloffFactor;
+	unsigned int ulFlags;
+} EAXREVERBPROPERTIES;
+
 typedef enum
 {
 	OPEN_HAWOS_RESOURCE_STOLEN = 0,
@@ -264,3 +369,27 @@ __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_GetLastStatus(void);
 __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_Reset(void);
 __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_Init(void);
 __declspec(dllexport) OPEN_SEGASTATUS SEGAAPI_Exit(void);
+
+// OpenSegaAPI extensions, not part of the original SEGA API.
+
+// With OPENSEGAAPI_OUTPUT=offline no device clock runs: the engine only advances when
+// the host renders, as fast as the CPU allows and with identical output for identical
+// call sequences. Output is interleaved 16-bit PCM in the format reported below.
+__declspec(dllexport) OPEN_SEGASTATUS OPENSEGAAPI_Render(short* pOutput, unsigned int dwFrames);
+__declspec(dllexport) OPEN_SEGASTATUS OPENSEGAAPI_GetOutputFormat(unsigned int* pdwSampleRate, unsigned int* pdwChannels);
+
+// Occupancy of the buffer pool and the sample memory arena. Sample buffers up to 256 KB
+// come from recycled size-classed blocks, bigger ones straight from the heap.
+typedef struct OPENSEGAAPI_MEMORYSTATS
+{
+	unsigned int dwBuffersInUse;
+	unsigned int dwBuffersPooled;
+	unsigned int dwSampleBlocksInUse;
+	unsigned int dwSampleBlocksFree;
+	unsigned int dwSampleBlockBytesInUse;
+	unsigned int dwSampleChunkBytes;
+	unsigned int dwLargeSampleBuffers;
+	unsigned int dwLargeSampleBytes;
+} OPENSEGAAPI_MEMORYSTATS;
+
+__declspec(dllexport) OPEN_SEGASTATUS OPENSEGAAPI_GetMemoryStats(OPENSEGAAPI_MEMORYSTATS* pStats);
@@ -0,0 +1,72 @@
+/*
+* This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+*
+* See LICENSE and MENTIONS in the root of the source tree for information
+* regarding licensing.
+*/
+#pragma once
+
+// Win32 types and helpers used by the platform-neutral core. On Windows these come
+// from the SDK, elsewhere a minimal shim lets the same sources build as a shared
+// object exporting the SEGAAPI_* entry points.
+
+#ifdef _WIN32
+
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <mmreg.h>
+#include <guiddef.h>
+
+#else
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define __declspec(x) __declspec_##x
+#define __declspec_dllexport __attribute__((visibility("default")))
+
+typedef uint32_t DWORD;
+typedef uint16_t WORD;
+typedef int BOOL;
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+#ifndef GUID_DEFINED
+#define GUID_DEFINED
+typedef struct _GUID
+{
+	uint32_t Data1;
+	uint16_t Data2;
+	uint16_t Data3;
+	uint8_t Data4[8];
+} GUID;
+#endif
+
+#define DEFINE_GUID(name, l, w1, w2, b1, b2, b3, b4, b5, b6, b7, b8) \
+	static const GUID name __attribute__((unused)) = { l, w1, w2, { b1, b2, b3, b4, b5, b6, b7, b8 } }
+
+#define WAVE_FORMAT_PCM 1
+
+typedef struct tWAVEFORMATEX
+{
+	WORD wFormatTag;
+	WORD nChannels;
+	DWORD nSamplesPerSec;
+	DWORD nAvgBytesPerSec;
+	WORD nBlockAlign;
+	WORD wBitsPerSample;
+	WORD cbSize;
+} WAVEFORMATEX;
+
+#define OutputDebugStringA(str) fputs(str, stderr)
+#define _vsnprintf_s(buffer, count, format, args) vsnprintf(buffer, count, format, args)
+
+#endif
@@ -0,0 +1,196 @@
+/*
+* This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+*
+* See LICENSE and MENTIONS in the root of the source tree for information
+* regarding licensing.
+*/
+#include "pool.h"
+#include "buffer.h"
+#include "log.h"
+
+#include <mutex>
+#include <new>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+
+#define POOL_CLASSES 7 // POOL_MIN_BLOCK << 0 .. POOL_MAX_BLOCK
+
+struct SizeClass
+{
+	std::vector<uint8_t*> freeBlocks; // recycled, contents are whatever was left in them
+	uint8_t* fresh;                   // next never used block in the current chunk
+	uint8_t* freshEnd;
+	unsigned int inUse;
+};
+
+static std::mutex g_poolMutex;
+static bool g_clearRecycled = true;
+
+static std::vector<OPEN_segaapiBuffer_t*> g_bufferSlabs;
+static std::vector<OPEN_segaapiBuffer_t*> g_freeBuffers;
+static unsigned int g_buffersInUse;
+
+static SizeClass g_classes[POOL_CLASSES];
+static std::vector<uint8_t*> g_chunks;
+static unsigned int g_largeInUse;
+static size_t g_largeBytesInUse;
+
+// Smallest class holding size, or -1 when it is too big for any
+static int sizeClass(size_t size)
+{
+	size_t blockSize = POOL_MIN_BLOCK;
+
+	for (int i = 0; i < POOL_CLASSES; i++)
+	{
+		if (size <= blockSize)
+			return i;
+		blockSize <<= 1;
+	}
+
+	return -1;
+}
+
+void poolInit()
+{
+	const char* clear = getenv("OPENSEGAAPI_CLEARBUFFERS");
+	g_clearRecycled = clear == nullptr || strcmp(clear, "0") != 0;
+
+	info("poolInit: Clearing recycled sample memory %s", g_clearRecycled ? "on" : "off");
+}
+
+OPEN_segaapiBuffer_t* poolAllocBuffer()
+{
+	std::lock_guard<std::mutex> lock(g_poolMutex);
+
+	if (g_freeBuffers.empty())
+	{
+		OPEN_segaapiBuffer_t* slab = (OPEN_segaapiBuffer_t*)malloc(sizeof(OPEN_segaapiBuffer_t) * POOL_BUFFERS_PER_SLAB);
+		if (slab == nullptr)
+			return nullptr;
+
+		g_bufferSlabs.push_back(slab);
+		g_freeBuffers.reserve(g_bufferSlabs.size() * POOL_BUFFERS_PER_SLAB);
+
+		// Reversed so buffers are handed out in address order
+		for (int i = POOL_BUFFERS_PER_SLAB - 1; i >= 0; i--)
+		{
+			g_freeBuffers.push_back(slab + i);
+		}
+	}
+
+	OPEN_segaapiBuffer_t* buffer = g_freeBuffers.back();
+	g_freeBuffers.pop_back();
+	g_buffersInUse++;
+
+	return new (buffer) OPEN_segaapiBuffer_t();
+}
+
+void poolFreeBuffer(OPEN_segaapiBuffer_t* buffer)
+{
+	buffer->~OPEN_segaapiBuffer_t();
+
+	std::lock_guard<std::mutex> lock(g_poolMutex);
+	g_freeBuffers.push_back(buffer);
+	g_buffersInUse--;
+}
+
+uint8_t* poolAllocSamples(size_t size, uint8_t silence)
+{
+	int index = sizeClass(size);
+
+	if (index < 0)
+	{
+		// Zero pages from calloc are only committed once the game writes them
+		uint8_t* data = (uint8_t*)(silence == 0 ? calloc(1, size) : malloc(size));
+		if (data == nullptr)
+			return nullptr;
+
+		if (silence != 0)
+			memset(data, silence, size);
+
+		std::lock_guard<std::mutex> lock(g_poolMutex);
+		g_largeInUse++;
+		g_largeBytesInUse += size;
+		return data;
+	}
+
+	size_t blockSize = (size_t)POOL_MIN_BLOCK << index;
+	SizeClass& sizes = g_classes[index];
+	uint8_t* block = nullptr;
+	bool clean = false;
+
+	{
+		std::lock_guard<std::mutex> lock(g_poolMutex);
+
+		if (!sizes.freeBlocks.empty())
+		{
+			block = sizes.freeBlocks.back();
+			sizes.freeBlocks.pop_back();
+		}
+		else
+		{
+			if (sizes.fresh == sizes.freshEnd)
+			{
+				uint8_t* chunk = (uint8_t*)calloc(1, POOL_CHUNK_SIZE);
+				if (chunk == nullptr)
+					return nullptr;
+
+				g_chunks.push_back(chunk);
+				sizes.fresh = chunk;
+				sizes.freshEnd = chunk + POOL_CHUNK_SIZE;
+			}
+
+			block = sizes.fresh;
+			sizes.fresh += blockSize;
+			clean = true;
+		}
+
+		sizes.inUse++;
+	}
+
+	// Never used blocks are still zero from calloc
+	if (clean ? silence != 0 : g_clearRecycled)
+		memset(block, silence, size);
+
+	return block;
+}
+
+void poolFreeSamples(uint8_t* data, size_t size)
+{
+	int index = sizeClass(size);
+
+	std::lock_guard<std::mutex> lock(g_poolMutex);
+
+	if (index < 0)
+	{
+		free(data);
+		g_largeInUse--;
+		g_largeBytesInUse -= size;
+		return;
+	}
+
+	g_classes[index].freeBlocks.push_back(data);
+	g_classes[index].inUse--;
+}
+
+void poolGetStats(PoolStats* stats)
+{
+	std::lock_guard<std::mutex> lock(g_poolMutex);
+
+	stats->buffersInUse = g_buffersInUse;
+	stats->buffersPooled = (unsigned int)(g_bufferSlabs.size() * POOL_BUFFERS_PER_SLAB);
+	stats->blocksInUse = 0;
+	stats->blocksFree = 0;
+	stats->blockBytesInUse = 0;
+	stats->chunkBytes = g_chunks.size() * (size_t)POOL_CHUNK_SIZE;
+	stats->largeInUse = g_largeInUse;
+	stats->largeBytesInUse = g_largeBytesInUse;
+
+	for (int i = 0; i < POOL_CLASSES; i++)
+	{
+		stats->blocksInUse += g_classes[i].inUse;
+		stats->blocksFree += (unsigned int)g_classes[i].freeBlocks.size();
+		stats->blockBytesInUse += g_classes[i].inUse * ((size_t)POOL_MIN_BLOCK << i);
+	}
+}
@@ -0,0 +1,48 @@
+/*
+* This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+*
+* See LICENSE and MENTIONS in the root of the source tree for information
+* regarding licensing.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct OPEN_segaapiBuffer_t;
+
+// Buffer objects come from slabs and sample memory up to POOL_MAX_BLOCK bytes from
+// power-of-two size classes carved out of POOL_CHUNK_SIZE chunks. Both are recycled
+// and only ever grow to the peak the game reaches, so create/destroy churn during
+// gameplay neither allocates nor fragments the heap. Bigger sample buffers, long
+// music tracks mostly, go straight to the heap.
+#define POOL_BUFFERS_PER_SLAB 64
+#define POOL_MIN_BLOCK 4096
+#define POOL_MAX_BLOCK (256 * 1024)
+#define POOL_CHUNK_SIZE (1024 * 1024)
+
+struct PoolStats
+{
+	unsigned int buffersInUse;
+	unsigned int buffersPooled;    // slab capacity, in use or not
+	unsigned int blocksInUse;
+	unsigned int blocksFree;
+	size_t blockBytesInUse;
+	size_t chunkBytes;             // reserved for blocks
+	unsigned int largeInUse;
+	size_t largeBytesInUse;
+};
+
+// Reads OPENSEGAAPI_CLEARBUFFERS, call before the first allocation.
+void poolInit();
+
+// Value-initialized, like new OPEN_segaapiBuffer_t().
+OPEN_segaapiBuffer_t* poolAllocBuffer();
+void poolFreeBuffer(OPEN_segaapiBuffer_t* buffer);
+
+// Sample memory reading as silence, every byte set to the given value. A recycled
+// block is not cleared when clearing is turned off. Free with the same size.
+uint8_t* poolAllocSamples(size_t size, uint8_t silence);
+void poolFreeSamples(uint8_t* data, size_t size);
+
+void poolGetStats(PoolStats* stats);
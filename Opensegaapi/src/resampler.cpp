@@ -0,0 +1,147 @@
+/*
+* This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+*
+* See LICENSE and MENTIONS in the root of the source tree for information
+* regarding licensing.
+*/
+#include "resampler.h"
+#include "log.h"
+
+#include <vector>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const double g_pi = 3.14159265358979323846;
+
+static const char* const g_names[] = { "nearest", "linear", "cubic", "sinc8", "sinc16", "sinc32" };
+static const double g_bandSteps[RESAMPLER_BANDS] = { 1.0, 1.25, 1.5, 2.0, 3.0, 4.0 };
+
+static unsigned int g_taps;
+static std::vector<float> g_tables; // RESAMPLER_BANDS tables back to back
+
+// Modified Bessel function of the first kind, order zero, for the Kaiser window
+static double besselI0(double x)
+{
+	double sum = 1.0;
+	double term = 1.0;
+
+	for (int k = 1; k < 32; k++)
+	{
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+
+		if (term < sum * 1e-12)
+			break;
+	}
+
+	return sum;
+}
+
+// Kaiser-windowed sinc. Cutoff is relative to the source Nyquist frequency; shorter
+// filters get a lower one and a gentler window, since their transition band is wider.
+static void buildTable(float* table, unsigned int taps, double cutoff, double beta)
+{
+	int left = (int)taps / 2 - 1;
+	double halfWidth = taps / 2.0;
+
+	for (unsigned int p = 0; p <= RESAMPLER_PHASES; p++)
+	{
+		float* row = table + p * taps;
+		double fraction = (double)p / RESAMPLER_PHASES;
+		double sum = 0.0;
+		double values[32];
+
+		for (unsigned int k = 0; k < taps; k++)
+		{
+			double distance = (int)k - left - fraction;
+			double x = distance * cutoff;
+			double sinc = fabs(x) < 1e-9 ? 1.0 : sin(g_pi * x) / (g_pi * x);
+			double ratio = distance / halfWidth;
+			double window = fabs(ratio) >= 1.0 ? 0.0 : besselI0(beta * sqrt(1.0 - ratio * ratio)) / besselI0(beta);
+
+			values[k] = cutoff * sinc * window;
+			sum += values[k];
+		}
+
+		for (unsigned int k = 0; k < taps; k++)
+		{
+			row[k] = (float)(values[k] / sum);
+		}
+	}
+}
+
+ResamplerQuality resamplerInit()
+{
+	ResamplerQuality quality = RESAMPLER_LINEAR;
+	const char* requested = getenv("OPENSEGAAPI_RESAMPLER");
+
+	if (requested != nullptr)
+	{
+		unsigned int i = 0;
+		while (i < sizeof(g_names) / sizeof(g_names[0]) && strcmp(requested, g_names[i]) != 0)
+			i++;
+
+		if (i < sizeof(g_names) / sizeof(g_names[0]))
+			quality = (ResamplerQuality)i;
+		else
+			info("resamplerInit: Unknown resampler %s, using %s", requested, g_names[quality]);
+	}
+
+	double rolloff, beta;
+
+	switch (quality)
+	{
+	case RESAMPLER_SINC8:
+		g_taps = 8;
+		rolloff = 0.80;
+		beta = 5.0;
+		break;
+	case RESAMPLER_SINC16:
+		g_taps = 16;
+		rolloff = 0.88;
+		beta = 7.0;
+		break;
+	case RESAMPLER_SINC32:
+		g_taps = 32;
+		rolloff = 0.94;
+		beta = 8.6;
+		break;
+	default:
+		g_taps = 0;
+		g_tables.clear();
+		return quality;
+	}
+
+	size_t tableSize = (size_t)(RESAMPLER_PHASES + 1) * g_taps;
+	g_tables.assign(tableSize * RESAMPLER_BANDS, 0.0f);
+
+	for (int band = 0; band < RESAMPLER_BANDS; band++)
+	{
+		buildTable(&g_tables[band * tableSize], g_taps, rolloff / g_bandSteps[band], beta);
+	}
+
+	info("resamplerInit: %d-tap sinc, %d phases, %d bytes of tables", g_taps, RESAMPLER_PHASES, g_tables.size() * sizeof(float));
+	return quality;
+}
+
+const char* resamplerName(ResamplerQuality quality)
+{
+	return g_names[quality];
+}
+
+unsigned int resamplerTaps()
+{
+	return g_taps;
+}
+
+const float* resamplerTable(double step)
+{
+	// The first band whose cutoff is low enough for this step, past the last one a
+	// voice pitched that far up aliases somewhat
+	int band = 0;
+	while (band < RESAMPLER_BANDS - 1 && step > g_bandSteps[band])
+		band++;
+
+	return &g_tables[band * (size_t)(RESAMPLER_PHASES + 1) * g_taps];
+}
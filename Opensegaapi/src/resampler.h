@@ -0,0 +1,39 @@
+/*
+* This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+*
+* See LICENSE and MENTIONS in the root of the source tree for information
+* regarding licensing.
+*/
+#pragma once
+
+// Fractional positions a sinc table has rows for, anything in between is interpolated
+#define RESAMPLER_PHASES 256
+
+// Sinc tables are built for steps up to 1, 1.25, 1.5, 2, 3 and 4 source frames per
+// output frame, each with its cutoff lowered to match
+#define RESAMPLER_BANDS 6
+
+enum ResamplerQuality
+{
+	RESAMPLER_NEAREST,
+	RESAMPLER_LINEAR,
+	RESAMPLER_CUBIC,
+	RESAMPLER_SINC8,
+	RESAMPLER_SINC16,
+	RESAMPLER_SINC32,
+};
+
+// Reads OPENSEGAAPI_RESAMPLER (nearest, linear, cubic, sinc8, sinc16 or sinc32, linear
+// when not set) and builds the tables the chosen quality needs.
+ResamplerQuality resamplerInit();
+const char* resamplerName(ResamplerQuality quality);
+
+// Taps of the sinc filter, 0 when the quality is not a sinc one
+unsigned int resamplerTaps();
+
+// Polyphase table for a voice reading step source frames per output frame, built by
+// resamplerInit. It has RESAMPLER_PHASES + 1 rows of resamplerTaps() coefficients, row p
+// for a position p / RESAMPLER_PHASES of the way from one source frame to the next.
+// Coefficient k of a row weighs the frame k - (taps / 2 - 1) from the one before the
+// position. Each row adds up to one.
+const float* resamplerTable(double step);
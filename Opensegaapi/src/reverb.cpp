@@ -0,0 +1,289 @@
+/*
+* This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+*
+* See LICENSE and MENTIONS in the root of the source tree for information
+* regarding licensing.
+*/
+#include "reverb.h"
+
+extern "C" {
+#include "opensegaapi.h"
+}
+
+#include <math.h>
+#include <string.h>
+
+// Delay line lengths in a 7.5 metre environment, EAX's default, stretched with the size
+static const float g_lineSeconds[REVERB_LINES] = { 0.0231f, 0.0277f, 0.0313f, 0.0359f, 0.0397f, 0.0433f, 0.0479f, 0.0539f };
+
+// Allpass lengths at 48 kHz, Freeverb's
+static const unsigned int g_diffuserFrames[REVERB_DIFFUSERS] = { 605, 480, 371, 245 };
+
+// Signs the lines are fed and read with. Rows of a Hadamard matrix, so the input and
+// the two sides reach the lines in uncorrelated mixes, and none of them in the all
+// equal one the Householder matrix just flips.
+static const float g_inputSigns[REVERB_LINES] = { 1, 1, 1, 1, -1, -1, -1, -1 };
+static const float g_leftSigns[REVERB_LINES] = { 1, -1, 1, -1, 1, -1, 1, -1 };
+static const float g_rightSigns[REVERB_LINES] = { 1, 1, -1, -1, 1, 1, -1, -1 };
+
+static float clampf(float value, float low, float high)
+{
+	return value < low ? low : value > high ? high : value;
+}
+
+// Pole of the one-pole low-pass that passes DC unchanged and scales by gain at the
+// frequency whose cosine, in radians per frame, is given
+static float dampingPole(float gain, float cosine)
+{
+	if (gain >= 1.0f)
+		return 0.0f;
+
+	float g2 = gain * gain;
+	float b = 1.0f - g2 * cosine;
+
+	return (b - sqrtf(b * b - (1.0f - g2) * (1.0f - g2))) / (1.0f - g2);
+}
+
+static void buildReverb(Reverb* reverb)
+{
+	const ReverbParameters& parameters = reverb->parameters;
+	float sampleRate = (float)reverb->sampleRate;
+	float scale = clampf(parameters.size / 7.5f, 0.25f, 3.0f);
+	float decayTime = clampf(parameters.decayTime, 0.1f, 20.0f);
+	float decayHFRatio = clampf(parameters.decayHFRatio, 0.1f, 2.0f);
+	float cosine = cosf(2.0f * 3.14159265f * clampf(parameters.hfReference, 1000.0f, sampleRate * 0.45f) / sampleRate);
+	unsigned int longest = 0;
+
+	for (unsigned int line = 0; line < REVERB_LINES; line++)
+	{
+		unsigned int frames = (unsigned int)(g_lineSeconds[line] * scale * sampleRate);
+		if (frames < REVERB_BLOCK_FRAMES) frames = REVERB_BLOCK_FRAMES;
+		if (frames > REVERB_LINE_FRAMES) frames = REVERB_LINE_FRAMES;
+
+		// Per pass round the line, what the decay time takes off at low frequencies and
+		// at the reference
+		float gain = powf(10.0f, -3.0f * frames / (decayTime * sampleRate));
+		float gainHF = powf(10.0f, -3.0f * frames / (decayTime * decayHFRatio * sampleRate));
+		float pole = dampingPole(gainHF / gain, cosine);
+
+		reverb->lineFrames[line] = frames;
+		reverb->coefficients[line] = pole;
+		reverb->coefficients[REVERB_LINES + line] = (1.0f - pole) * gain;
+
+		if (frames > longest)
+			longest = frames;
+	}
+
+	float lateGain = parameters.room * parameters.reverb * parameters.volume / sqrtf((float)REVERB_LINES);
+
+	for (unsigned int line = 0; line < REVERB_LINES; line++)
+	{
+		reverb->coefficients[REVERB_LINES * 2 + line] = g_inputSigns[line] / sqrtf((float)REVERB_LINES);
+		reverb->coefficients[REVERB_LINES * 3 + line] = g_leftSigns[line] * lateGain;
+		reverb->coefficients[REVERB_LINES * 4 + line] = g_rightSigns[line] * lateGain;
+	}
+
+	// The right side's reflections come a little later than the left's
+	unsigned int maxTap = REVERB_INPUT_FRAMES - REVERB_BLOCK_FRAMES;
+	unsigned int reflectionsFrames = (unsigned int)(clampf(parameters.reflectionsDelay, 0.0f, 0.3f) * sampleRate);
+	unsigned int spreadFrames = (unsigned int)(0.0043f * scale * sampleRate);
+	unsigned int reverbFrames = (unsigned int)(clampf(parameters.reverbDelay, 0.0f, 0.1f) * sampleRate);
+
+	reverb->leftTap = reflectionsFrames < maxTap ? reflectionsFrames : maxTap;
+	reverb->rightTap = reflectionsFrames + spreadFrames < maxTap ? reflectionsFrames + spreadFrames : maxTap;
+	reverb->lateTap = reflectionsFrames + reverbFrames < maxTap ? reflectionsFrames + reverbFrames : maxTap;
+	reverb->reflectionsGain = parameters.room * parameters.reflections * parameters.volume;
+	reverb->diffuserGain = 0.6f * clampf(parameters.diffusion, 0.0f, 1.0f);
+	reverb->inputPole = dampingPole(clampf(parameters.roomHF, 0.0f, 1.0f), cosine);
+
+	unsigned int diffused = 0;
+	for (unsigned int i = 0; i < REVERB_DIFFUSERS; i++)
+	{
+		reverb->diffuserFrames[i] = (unsigned int)(g_diffuserFrames[i] * sampleRate / 48000.0f);
+		if (reverb->diffuserFrames[i] > REVERB_DIFFUSER_FRAMES)
+			reverb->diffuserFrames[i] = REVERB_DIFFUSER_FRAMES;
+
+		diffused += reverb->diffuserFrames[i];
+	}
+
+	// Until the late reverb is 90dB down, past anything 16-bit output can show
+	reverb->tailFrames = reverb->lateTap + diffused + longest + (unsigned int)(1.5f * decayTime * sampleRate);
+	reverb->dirty = false;
+}
+
+static void clearReverb(Reverb* reverb)
+{
+	reverb->inputState = 0.0f;
+	memset(reverb->lineState, 0, sizeof(reverb->lineState));
+	memset(reverb->input, 0, sizeof(reverb->input));
+	memset(reverb->lines, 0, sizeof(reverb->lines));
+	memset(reverb->diffusers, 0, sizeof(reverb->diffusers));
+}
+
+void reverbInit(Reverb* reverb, unsigned int sampleRate)
+{
+	ReverbParameters& parameters = reverb->parameters;
+
+	parameters.size = 7.5f;
+	parameters.diffusion = 1.0f;
+	parameters.room = powf(10.0f, -1000 / 2000.0f);
+	parameters.roomHF = powf(10.0f, -100 / 2000.0f);
+	parameters.decayTime = 1.49f;
+	parameters.decayHFRatio = 0.83f;
+	parameters.reflections = powf(10.0f, -2602 / 2000.0f);
+	parameters.reflectionsDelay = 0.007f;
+	parameters.reverb = powf(10.0f, 200 / 2000.0f);
+	parameters.reverbDelay = 0.011f;
+	parameters.hfReference = 5000.0f;
+	parameters.volume = 1.0f;
+
+	reverb->sampleRate = sampleRate;
+	reverb->dirty = true;
+	reverb->framesLeft = 0;
+	reverb->inputPosition = 0;
+	reverb->linePosition = 0;
+	memset(reverb->diffuserPositions, 0, sizeof(reverb->diffuserPositions));
+	clearReverb(reverb);
+}
+
+void reverbSetParameter(Reverb* reverb, unsigned int property, float value)
+{
+	ReverbParameters& parameters = reverb->parameters;
+
+	switch (property)
+	{
+	case EAXREVERB_ENVIRONMENTSIZE: parameters.size = value; break;
+	case EAXREVERB_ENVIRONMENTDIFFUSION: parameters.diffusion = value; break;
+	case EAXREVERB_ROOM: parameters.room = value; break;
+	case EAXREVERB_ROOMHF: parameters.roomHF = value; break;
+	case EAXREVERB_DECAYTIME: parameters.decayTime = value; break;
+	case EAXREVERB_DECAYHFRATIO: parameters.decayHFRatio = value; break;
+	case EAXREVERB_REFLECTIONS: parameters.reflections = value; break;
+	case EAXREVERB_REFLECTIONSDELAY: parameters.reflectionsDelay = value; break;
+	case EAXREVERB_REVERB: parameters.reverb = value; break;
+	case EAXREVERB_REVERBDELAY: parameters.reverbDelay = value; break;
+	case EAXREVERB_HFREFERENCE: parameters.hfReference = value; break;
+	case EAXFXSLOT_VOLUME: parameters.volume = value; break;
+	default: return;
+	}
+
+	reverb->dirty = true;
+}
+
+// One block, no longer than the shortest line
+static void processBlock(Reverb* reverb, const MixerKernels* kernels, const float* input, float* left, float* right, unsigned int frames)
+{
+	alignas(32) float lanes[REVERB_BLOCK_FRAMES * REVERB_LINES];
+	float late[REVERB_BLOCK_FRAMES];
+	float reflections[2][REVERB_BLOCK_FRAMES];
+	const unsigned int inputMask = REVERB_INPUT_FRAMES - 1;
+	const unsigned int lineMask = REVERB_LINE_FRAMES - 1;
+	unsigned int position = reverb->inputPosition;
+
+	// Input, with its high frequencies absorbed, into the predelay
+	float state = reverb->inputState;
+	for (unsigned int i = 0; i < frames; i++)
+	{
+		float sample = input != nullptr ? input[i] : 0.0f;
+		state = sample + (state - sample) * reverb->inputPole;
+		reverb->input[(position + i) & inputMask] = state;
+	}
+	reverb->inputState = state;
+
+	for (unsigned int i = 0; i < frames; i++)
+	{
+		reflections[0][i] = reverb->input[(position + i - reverb->leftTap) & inputMask];
+		reflections[1][i] = reverb->input[(position + i - reverb->rightTap) & inputMask];
+		late[i] = reverb->input[(position + i - reverb->lateTap) & inputMask];
+	}
+	reverb->inputPosition = (position + frames) & inputMask;
+
+	for (unsigned int d = 0; d < REVERB_DIFFUSERS; d++)
+	{
+		float* buffer = reverb->diffusers[d];
+		unsigned int length = reverb->diffuserFrames[d];
+		unsigned int at = reverb->diffuserPositions[d];
+		float gain = reverb->diffuserGain;
+
+		for (unsigned int i = 0; i < frames; i++)
+		{
+			float delayed = buffer[at];
+			float fed = late[i] - gain * delayed;
+
+			buffer[at] = fed;
+			late[i] = delayed + gain * fed;
+
+			if (++at == length)
+				at = 0;
+		}
+
+		reverb->diffuserPositions[d] = at;
+	}
+
+	// What the lines put out this block was all written before it
+	position = reverb->linePosition;
+	for (unsigned int line = 0; line < REVERB_LINES; line++)
+	{
+		const float* samples = reverb->lines[line];
+		unsigned int read = position - reverb->lineFrames[line];
+
+		for (unsigned int i = 0; i < frames; i++)
+		{
+			lanes[i * REVERB_LINES + line] = samples[(read + i) & lineMask];
+		}
+	}
+
+	kernels->reverbLines(lanes, reverb->lineState, reverb->coefficients, late, left, right, frames);
+
+	for (unsigned int line = 0; line < REVERB_LINES; line++)
+	{
+		float* samples = reverb->lines[line];
+
+		for (unsigned int i = 0; i < frames; i++)
+		{
+			samples[(position + i) & lineMask] = lanes[i * REVERB_LINES + line];
+		}
+	}
+	reverb->linePosition = (position + frames) & lineMask;
+
+	for (unsigned int i = 0; i < frames; i++)
+	{
+		left[i] += reflections[0][i] * reverb->reflectionsGain;
+		right[i] += reflections[1][i] * reverb->reflectionsGain;
+	}
+}
+
+bool reverbProcess(Reverb* reverb, const MixerKernels* kernels, const float* input, float* left, float* right, unsigned int frames)
+{
+	if (input == nullptr && reverb->framesLeft == 0)
+		return false;
+
+	if (reverb->dirty)
+		buildReverb(reverb);
+
+	if (input != nullptr)
+		reverb->framesLeft = reverb->tailFrames;
+
+	for (unsigned int done = 0; done < frames; )
+	{
+		unsigned int count = frames - done;
+		if (count > REVERB_BLOCK_FRAMES)
+			count = REVERB_BLOCK_FRAMES;
+
+		processBlock(reverb, kernels, input != nullptr ? input + done : nullptr, left + done, right + done, count);
+		done += count;
+	}
+
+	// Died away, silent again from here on
+	if (reverb->framesLeft <= frames)
+	{
+		reverb->framesLeft = 0;
+		clearReverb(reverb);
+	}
+	else
+	{
+		reverb->framesLeft -= frames;
+	}
+
+	return true;
+}
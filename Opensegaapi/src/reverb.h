@@ -0,0 +1,88 @@
+/*
+* This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+*
+* See LICENSE and MENTIONS in the root of the source tree for information
+* regarding licensing.
+*/
+#pragma once
+
+#include "mixer_kernels.h"
+
+// Delay lines of the feedback network, one per lane of the mixer's lane kernels
+#define REVERB_LINES MIXER_FILTER_LANES
+
+// Frames processed at a time. No line is ever shorter, so a whole block of what the
+// lines put out is known before any of it is fed back.
+#define REVERB_BLOCK_FRAMES 256
+
+// Longest a delay line and the input delay can get, in frames at 48 kHz. Both powers
+// of two, so positions wrap with a mask.
+#define REVERB_LINE_FRAMES 8192
+#define REVERB_INPUT_FRAMES 32768
+
+// Allpasses that smear the input before it reaches the lines
+#define REVERB_DIFFUSERS 4
+#define REVERB_DIFFUSER_FRAMES 1024
+
+// Linear gains, seconds, metres and Hz, converted from the EAX reverb properties
+struct ReverbParameters
+{
+	float size;               // environment size, scales every delay line
+	float diffusion;          // 0 to 1
+	float room;               // level of the whole effect
+	float roomHF;             // of the input at hfReference
+	float decayTime;          // to -60dB at low frequencies
+	float decayHFRatio;       // decay time at hfReference relative to decayTime
+	float reflections;        // level of the early reflections
+	float reflectionsDelay;   // from the input to the early reflections
+	float reverb;             // level of the late reverb
+	float reverbDelay;        // from the early reflections to the late reverb
+	float hfReference;
+	float volume;             // of the FX slot the reverb is loaded in
+};
+
+// Feedback delay network reverb with a mono input and a stereo output, like an EAX FX
+// slot. The input goes through a predelay, an early reflection tap for each side and a
+// few allpasses into REVERB_LINES delay lines, which feed back into each other through
+// a Householder matrix, each damped so the high frequencies die away faster.
+struct Reverb
+{
+	ReverbParameters parameters;
+	unsigned int sampleRate;
+	bool dirty;               // parameters changed, coefficients rebuilt before the next block
+
+	// Built from the parameters
+	unsigned int lineFrames[REVERB_LINES];
+	unsigned int leftTap;     // frames back into the input delay of each side's reflections
+	unsigned int rightTap;
+	unsigned int lateTap;     // and of the late reverb
+	unsigned int diffuserFrames[REVERB_DIFFUSERS];
+	float diffuserGain;
+	float inputPole;          // one-pole of roomHF
+	float reflectionsGain;
+	float coefficients[REVERB_LINES * 5]; // laid out as reverbLines takes them
+	unsigned int tailFrames;  // frames the reverb rings for after its input stops
+
+	// Playback state
+	unsigned int framesLeft;  // of the tail, 0 while idle
+	float inputState;
+	float lineState[REVERB_LINES];
+	unsigned int inputPosition;
+	unsigned int linePosition;
+	unsigned int diffuserPositions[REVERB_DIFFUSERS];
+	float input[REVERB_INPUT_FRAMES];
+	float lines[REVERB_LINES][REVERB_LINE_FRAMES];
+	float diffusers[REVERB_DIFFUSERS][REVERB_DIFFUSER_FRAMES];
+};
+
+// EAX defaults, the generic environment
+void reverbInit(Reverb* reverb, unsigned int sampleRate);
+
+// Property is one of EAXREVERB_* or EAXFXSLOT_VOLUME, the value in ReverbParameters'
+// units. Takes effect from the next block.
+void reverbSetParameter(Reverb* reverb, unsigned int property, float value);
+
+// Overwrites left and right with frames of output. Input is null when nothing was sent
+// to the reverb, which then only plays out its tail. Returns false without touching
+// the output once the tail has died away, until input comes again.
+bool reverbProcess(Reverb* reverb, const MixerKernels* kernels, const float* input, float* left, float* right, unsigned int frames);
@@ -0,0 +1,37 @@
+/*
+* This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+*
+* See LICENSE and MENTIONS in the root of the source tree for information
+* regarding licensing.
+*/
+#include "tests.h"
+
+#include <stdio.h>
+
+int main()
+{
+	struct Test
+	{
+		const char* name;
+		bool(*run)();
+	};
+
+	const Test tests[] = {
+		{ "kernels", testKernels },
+		{ "loops", testLoops },
+		{ "stealing", testStealing },
+	};
+
+	int failures = 0;
+
+	for (const Test& test : tests)
+	{
+		bool passed = test.run();
+		printf("%s: %s\n", test.name, passed ? "passed" : "FAILED");
+
+		if (!passed)
+			failures++;
+	}
+
+	return failures == 0 ? 0 : 1;
+}
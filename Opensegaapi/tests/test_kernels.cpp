@@ -0,0 +1,234 @@
+/*
+* This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+*
+* See LICENSE and MENTIONS in the root of the source tree for information
+* regarding licensing.
+*/
+#include "tests.h"
+#include "mixer_kernels.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static bool checkKernels(const MixerKernels* scalar, const MixerKernels* kernels)
+{
+	const unsigned int maxFrames = 67;
+	const unsigned int maxChannels = 3;
+	const unsigned int maxPorts = 6;
+
+	uint8_t u8[maxFrames * maxChannels];
+	int16_t s16[maxFrames * maxChannels];
+	float f32[maxFrames];
+	float gains[maxChannels * maxPorts];
+	float expected[maxPorts][maxFrames], actual[maxPorts][maxFrames];
+	int16_t expectedOut[maxFrames * maxPorts], actualOut[maxFrames * maxPorts];
+
+	unsigned int seed = 12345;
+	auto next = [&seed]() { seed = seed * 1103515245 + 12345; return seed >> 8; };
+
+	for (unsigned int i = 0; i < maxFrames * maxChannels; i++)
+	{
+		u8[i] = (uint8_t)next();
+		s16[i] = (int16_t)next();
+	}
+
+	for (unsigned int i = 0; i < maxFrames; i++)
+	{
+		f32[i] = (int)(next() & 0xFFFF) / 32768.0f - 1.0f;
+	}
+
+	for (unsigned int i = 0; i < maxChannels * maxPorts; i++)
+	{
+		gains[i] = (next() & 0xFFFF) / 32768.0f;
+	}
+
+	// Every output layout and every frame count up to a few vectors, so each
+	// remainder length is exercised
+	for (unsigned int ports = 2; ports <= maxPorts; ports += 2)
+	{
+		float* expectedBus[maxPorts];
+		float* actualBus[maxPorts];
+
+		for (unsigned int port = 0; port < maxPorts; port++)
+		{
+			expectedBus[port] = expected[port];
+			actualBus[port] = actual[port];
+		}
+
+		for (unsigned int channels = 1; channels <= maxChannels; channels++)
+		{
+			for (unsigned int frames = 0; frames <= maxFrames; frames++)
+			{
+				for (int pass = 0; pass < 4; pass++)
+				{
+					for (unsigned int port = 0; port < maxPorts; port++)
+					{
+						for (unsigned int i = 0; i < maxFrames; i++)
+						{
+							expected[port][i] = actual[port][i] = (int)(next() & 0xFFFF) / 16384.0f - 2.0f;
+						}
+					}
+
+					switch (pass)
+					{
+					case 0:
+						scalar->mixU8(expectedBus, ports, u8, channels, gains, frames);
+						kernels->mixU8(actualBus, ports, u8, channels, gains, frames);
+						break;
+					case 1:
+						scalar->mixS16(expectedBus, ports, s16, channels, gains, frames);
+						kernels->mixS16(actualBus, ports, s16, channels, gains, frames);
+						break;
+					case 2:
+						scalar->mixF32(expectedBus, ports, f32, gains, frames);
+						kernels->mixF32(actualBus, ports, f32, gains, frames);
+						break;
+					case 3:
+						scalar->outputS16(expectedOut, expectedBus, ports, frames);
+						kernels->outputS16(actualOut, actualBus, ports, frames);
+
+						if (memcmp(expectedOut, actualOut, frames * ports * sizeof(int16_t)) != 0)
+							return false;
+						break;
+					}
+
+					if (memcmp(expected, actual, sizeof(expected)) != 0)
+						return false;
+				}
+			}
+		}
+	}
+
+	// Filter rows and sources of random values, every tap count the resampler has
+	const unsigned int maxTaps = 32;
+	float rows[maxTaps * 2], source[maxFrames + maxTaps], fractions[maxFrames];
+	unsigned int offsets[maxFrames];
+	const float* phases[maxFrames];
+	float* expectedFiltered = expected[0];
+	float* actualFiltered = actual[0];
+
+	for (unsigned int i = 0; i < maxTaps * 2; i++)
+	{
+		rows[i] = (int)(next() & 0xFFFF) / 65536.0f - 0.5f;
+	}
+
+	for (unsigned int i = 0; i < maxFrames + maxTaps; i++)
+	{
+		source[i] = (int)(next() & 0xFFFF) / 32768.0f - 1.0f;
+	}
+
+	for (unsigned int i = 0; i < maxFrames; i++)
+	{
+		offsets[i] = next() % maxFrames;
+		fractions[i] = (next() & 0xFFFF) / 65536.0f;
+	}
+
+	for (unsigned int taps = 8; taps <= maxTaps; taps *= 2)
+	{
+		for (unsigned int i = 0; i < maxFrames; i++)
+		{
+			phases[i] = rows + next() % (maxTaps * 2 - taps * 2 + 1);
+		}
+
+		scalar->convolve(expectedFiltered, source, offsets, phases, fractions, taps, maxFrames);
+		kernels->convolve(actualFiltered, source, offsets, phases, fractions, taps, maxFrames);
+
+		if (memcmp(expectedFiltered, actualFiltered, maxFrames * sizeof(float)) != 0)
+			return false;
+	}
+
+	// Rising and falling ramps over every length up to a few vectors
+	for (unsigned int frames = 0; frames <= maxFrames; frames++)
+	{
+		float gain = (next() & 0xFFFF) / 65536.0f;
+		float step = ((int)(next() & 0xFFFF) - 32768) / (32768.0f * maxFrames);
+
+		memcpy(expectedFiltered, f32, sizeof(f32));
+		memcpy(actualFiltered, f32, sizeof(f32));
+
+		scalar->applyRamp(expectedFiltered, gain, step, frames);
+		kernels->applyRamp(actualFiltered, gain, step, frames);
+
+		if (memcmp(expectedFiltered, actualFiltered, maxFrames * sizeof(float)) != 0)
+			return false;
+	}
+
+	// Each lane a different filter, sweeping, over random input
+	const unsigned int lanes = MIXER_FILTER_LANES;
+	float lanesIn[maxFrames * lanes], expectedLanes[maxFrames * lanes], actualLanes[maxFrames * lanes];
+	float coefficients[lanes * 6], expectedState[lanes * 2], actualState[lanes * 2];
+
+	for (unsigned int i = 0; i < maxFrames * lanes; i++)
+	{
+		lanesIn[i] = (int)(next() & 0xFFFF) / 32768.0f - 1.0f;
+	}
+
+	for (unsigned int lane = 0; lane < lanes; lane++)
+	{
+		float a0 = (next() & 0xFFFF) / 262144.0f;
+		coefficients[lane] = a0;
+		coefficients[lanes + lane] = -1.5f + a0;
+		coefficients[lanes * 2 + lane] = 0.6f;
+		coefficients[lanes * 3 + lane] = ((int)(next() & 0xFF) - 128) / 1e6f;
+		coefficients[lanes * 4 + lane] = ((int)(next() & 0xFF) - 128) / 1e6f;
+		coefficients[lanes * 5 + lane] = ((int)(next() & 0xFF) - 128) / 1e6f;
+		expectedState[lane] = actualState[lane] = (int)(next() & 0xFFFF) / 65536.0f - 0.5f;
+		expectedState[lanes + lane] = actualState[lanes + lane] = (int)(next() & 0xFFFF) / 65536.0f - 0.5f;
+	}
+
+	memcpy(expectedLanes, lanesIn, sizeof(lanesIn));
+	memcpy(actualLanes, lanesIn, sizeof(lanesIn));
+
+	scalar->lowpass(expectedLanes, expectedState, coefficients, maxFrames);
+	kernels->lowpass(actualLanes, actualState, coefficients, maxFrames);
+
+	if (memcmp(expectedLanes, actualLanes, sizeof(expectedLanes)) != 0 || memcmp(expectedState, actualState, sizeof(expectedState)) != 0)
+		return false;
+
+	// The same lanes as delay line outputs, with random damping and gains
+	float reverbCoefficients[lanes * 5];
+	float* expectedLeft = expected[0];
+	float* expectedRight = expected[1];
+	float* actualLeft = actual[0];
+	float* actualRight = actual[1];
+
+	for (unsigned int i = 0; i < lanes * 5; i++)
+	{
+		reverbCoefficients[i] = (int)(next() & 0xFFFF) / 65536.0f - 0.5f;
+	}
+
+	memcpy(expectedLanes, lanesIn, sizeof(lanesIn));
+	memcpy(actualLanes, lanesIn, sizeof(lanesIn));
+
+	scalar->reverbLines(expectedLanes, expectedState, reverbCoefficients, f32, expectedLeft, expectedRight, maxFrames);
+	kernels->reverbLines(actualLanes, actualState, reverbCoefficients, f32, actualLeft, actualRight, maxFrames);
+
+	if (memcmp(expectedLanes, actualLanes, sizeof(expectedLanes)) != 0 || memcmp(expectedState, actualState, lanes * sizeof(float)) != 0 ||
+		memcmp(expectedLeft, actualLeft, maxFrames * sizeof(float)) != 0 || memcmp(expectedRight, actualRight, maxFrames * sizeof(float)) != 0)
+		return false;
+
+	return true;
+}
+
+bool testKernels()
+{
+	const MixerKernels* scalar = mixerKernelSet(0);
+	bool matches = true;
+
+	for (unsigned int i = 1; mixerKernelSet(i) != nullptr; i++)
+	{
+		const MixerKernels* kernels = mixerKernelSet(i);
+
+		if (checkKernels(scalar, kernels))
+		{
+			printf("testKernels: %s matches scalar\n", kernels->name);
+		}
+		else
+		{
+			printf("testKernels: %s DIFFERS from scalar\n", kernels->name);
+			matches = false;
+		}
+	}
+
+	return matches;
+}
@@ -0,0 +1,141 @@
+/*
+* This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+*
+* See LICENSE and MENTIONS in the root of the source tree for information
+* regarding licensing.
+*/
+#include "tests.h"
+#include "resampler.h"
+
+#include <math.h>
+#include <stdio.h>
+
+// Plays a ramp with a loop in its middle through the direct path and each resampler at
+// a few rates, then again as a one-shot whose end offset comes before its loop start,
+// and checks every output frame against the ramp unrolled by hand. A seam that drops,
+// repeats or blends the wrong frame, or an end that stops one frame off, shows up as a
+// mismatch of far more than the one step the 16-bit output rounds to.
+bool testLoops()
+{
+	const char* resamplers[] = { "nearest", "linear", "cubic", "sinc8", "sinc16", "sinc32" };
+	const unsigned int totalFrames = 100;
+	const unsigned int loopStart = 20;
+	const unsigned int loopEnd = 60;
+	const unsigned int endOffset = 50;
+	const unsigned int periods = 3;
+	const double steps[] = { 1.0, 0.5, 0.75, 1.5 };
+
+	static int16_t ramp[totalFrames];
+	for (unsigned int i = 0; i < totalFrames; i++)
+	{
+		ramp[i] = (int16_t)(i * 300 - 15000);
+	}
+
+	static int16_t output[MIXER_PERIOD_FRAMES * 2];
+	bool matches = true;
+
+	// In ResamplerQuality order
+	for (unsigned int r = 0; r < sizeof(resamplers) / sizeof(resamplers[0]); r++)
+	{
+		const char* name = resamplers[r];
+		ResamplerQuality resampler = (ResamplerQuality)r;
+		testSetEnv("OPENSEGAAPI_RESAMPLER", name);
+		mixerInit(MIXER_SAMPLE_RATE, 2);
+
+		for (int loop = 1; loop >= 0; loop--)
+		{
+			for (double step : steps)
+			{
+				MixerVoice voice{};
+				testInitVoice(&voice, ramp, totalFrames);
+				voice.loop = loop != 0;
+				voice.startLoop = (loop ? loopStart : endOffset + 10) * sizeof(int16_t);
+				voice.endLoop = loopEnd * sizeof(int16_t);
+				voice.endOffset = endOffset * sizeof(int16_t);
+				voice.frequency = (float)step;
+
+				testSubmit(&voice, MIXER_CMD_SET_POSITION, 0);
+				testSubmit(&voice, MIXER_CMD_PLAY, 1);
+
+				for (unsigned int period = 0; period < periods && matches; period++)
+				{
+					mixerRender(output, MIXER_PERIOD_FRAMES);
+
+					for (unsigned int i = 0; i < MIXER_PERIOD_FRAMES; i++)
+					{
+						double pos = (period * MIXER_PERIOD_FRAMES + i) * step;
+						unsigned int index = (unsigned int)pos;
+						float expected = 0.0f;
+
+						if (loop || pos < endOffset)
+						{
+							// Past the loop end the source repeats the loop, past the end offset
+							// a one-shot holds its last frame for the final blend
+							auto unrolled = [&](unsigned int frame)
+							{
+								if (!loop)
+									return ramp[frame < endOffset ? frame : endOffset - 1];
+								return ramp[frame < loopEnd ? frame : loopStart + (frame - loopStart) % (loopEnd - loopStart)];
+							};
+
+							float a = unrolled(index) * (1.0f / 32768.0f);
+							float b = unrolled(index + 1) * (1.0f / 32768.0f);
+							expected = a + (b - a) * (float)(pos - index);
+						}
+
+						if ((loop || pos < endOffset) && resampler != RESAMPLER_LINEAR && step != 1.0)
+						{
+							// The filters hear silence past the end offset instead
+							auto unrolled = [&](int frame)
+							{
+								if (frame < 0 || (!loop && frame >= (int)endOffset))
+									return 0.0f;
+								if (loop && frame >= (int)loopEnd)
+									frame = loopStart + (frame - loopStart) % (loopEnd - loopStart);
+								return ramp[frame] * (1.0f / 32768.0f);
+							};
+
+							float fraction = (float)(pos - index);
+
+							if (resampler == RESAMPLER_NEAREST)
+							{
+								expected = unrolled(index + (fraction >= 0.5f ? 1 : 0));
+							}
+							else if (resampler == RESAMPLER_CUBIC)
+							{
+								float p0 = unrolled(index - 1), p1 = unrolled(index), p2 = unrolled(index + 1), p3 = unrolled(index + 2);
+								expected = p1 + 0.5f * fraction * (p2 - p0 + fraction * (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3 + fraction * (3.0f * (p1 - p2) + p3 - p0)));
+							}
+							else
+							{
+								unsigned int taps = resamplerTaps();
+								float phase = fraction * RESAMPLER_PHASES;
+								unsigned int row = (unsigned int)phase < RESAMPLER_PHASES ? (unsigned int)phase : RESAMPLER_PHASES - 1;
+								const float* coefficients = resamplerTable(step) + row * taps;
+
+								expected = 0.0f;
+								for (unsigned int k = 0; k < taps; k++)
+								{
+									float coefficient = coefficients[k] + (coefficients[k + taps] - coefficients[k]) * (phase - row);
+									expected += unrolled((int)(index + k) - (int)taps / 2 + 1) * coefficient;
+								}
+							}
+						}
+
+						if (fabsf(output[i * 2] - expected * 32767.0f) > 1.0f)
+						{
+							printf("testLoops: %s loop=%d step=%f frame %d is %d, expected %f\n", name, loop, step, period * MIXER_PERIOD_FRAMES + i, output[i * 2], expected * 32767.0f);
+							matches = false;
+							break;
+						}
+					}
+				}
+
+				testSubmit(&voice, MIXER_CMD_STOP, 0);
+				mixerFlush();
+			}
+		}
+	}
+
+	return matches;
+}
@@ -0,0 +1,68 @@
+/*
+* This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+*
+* See LICENSE and MENTIONS in the root of the source tree for information
+* regarding licensing.
+*/
+#include "tests.h"
+
+#include <stdio.h>
+
+// Starts a synth note with a long attack over a budget of two sustaining notes and
+// checks the stolen voice is the quieter of those, not the new note still near level 0.
+bool testStealing()
+{
+	const unsigned int frames = 1000;
+	const float sustains[] = { 0.5f, 0.25f };
+
+	static int16_t tone[frames];
+	for (unsigned int i = 0; i < frames; i++)
+	{
+		tone[i] = (int16_t)((i * 37) % 20000 - 10000);
+	}
+
+	testSetEnv("OPENSEGAAPI_MAXVOICES", "2");
+	mixerInit(MIXER_SAMPLE_RATE, 2);
+
+	static int16_t output[MIXER_PERIOD_FRAMES * 2];
+	MixerVoice voices[3] = {};
+
+	for (int i = 0; i < 3; i++)
+	{
+		MixerVoice* voice = &voices[i];
+		testInitVoice(voice, tone, frames);
+		voice->synth = true;
+		voice->loop = true;
+
+		if (i < 2)
+			testSubmit(voice, MIXER_CMD_SET_SYNTH_PARAM, 0, sustains[i], OPEN_HAVP_SUSTAIN_VOL_ENV);
+		else
+			testSubmit(voice, MIXER_CMD_SET_SYNTH_PARAM, 0, 1.0f, OPEN_HAVP_ATTACK_VOL_ENV);
+
+		testSubmit(voice, MIXER_CMD_PLAY, 1);
+		mixerRender(output, MIXER_PERIOD_FRAMES);
+	}
+
+	// A stolen voice is reported finished
+	bool stolen[3];
+	for (int i = 0; i < 3; i++)
+	{
+		stolen[i] = voices[i].finishedSerial.load() == 1;
+	}
+
+	for (MixerVoice& voice : voices)
+	{
+		testSubmit(&voice, MIXER_CMD_STOP, 0);
+	}
+
+	mixerFlush();
+	testSetEnv("OPENSEGAAPI_MAXVOICES", "256");
+
+	if (stolen[0] || !stolen[1] || stolen[2])
+	{
+		printf("testStealing: stolen %d %d %d, expected only the quieter sustaining note\n", stolen[0], stolen[1], stolen[2]);
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,30 @@
+/*
+* This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+*
+* See LICENSE and MENTIONS in the root of the source tree for information
+* regarding licensing.
+*/
+#pragma once
+
+#include "mixer.h"
+
+// Each prints what it checked and returns false on any mismatch
+
+// Every SIMD kernel set this CPU supports against the scalar one, bit for bit
+bool testKernels();
+
+// Every resampler through a loop seam and up to a one-shot's end offset, frame by frame
+bool testLoops();
+
+// Voice stealing at the OPENSEGAAPI_MAXVOICES budget, with a synth note in its attack
+bool testStealing();
+
+// Sets an environment variable the core reads at init
+void testSetEnv(const char* name, const char* value);
+
+// Mono 16-bit voice at 48 kHz, routed to the front left port at full level with
+// everything else as a new buffer has it. Not known to the mixer until it is played.
+void testInitVoice(MixerVoice* voice, const int16_t* data, unsigned int frames);
+
+// Queues one command for the voice, applied at the start of the next render
+void testSubmit(MixerVoice* voice, MixerCommandType type, int param, float value = 0.0f, unsigned int index = 0);
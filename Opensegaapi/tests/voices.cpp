@@ -0,0 +1,68 @@
+/*
+* This file is part of the OpenParrot project - https://teknoparrot.com / https://github.com/teknogods
+*
+* See LICENSE and MENTIONS in the root of the source tree for information
+* regarding licensing.
+*/
+#include "tests.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+void testSetEnv(const char* name, const char* value)
+{
+#ifdef _WIN32
+	_putenv_s(name, value);
+#else
+	setenv(name, value, 1);
+#endif
+}
+
+void testInitVoice(MixerVoice* voice, const int16_t* data, unsigned int frames)
+{
+	voice->data = (const uint8_t*)data;
+	voice->channels = 1;
+	voice->sampleFormat = OPEN_HASF_SIGNED_16PCM;
+	voice->blockAlign = sizeof(int16_t);
+	voice->totalFrames = frames;
+	voice->loop = false;
+	voice->startLoop = 0;
+	voice->endLoop = frames * sizeof(int16_t);
+	voice->endOffset = frames * sizeof(int16_t);
+	voice->sampleRate = MIXER_SAMPLE_RATE;
+	voice->frequency = 1.0f;
+
+	for (int i = 0; i < 7; i++)
+	{
+		voice->sendRoutes[i] = i == 0 ? OPEN_HA_FRONT_LEFT_PORT : OPEN_HA_UNUSED_PORT;
+		voice->sendChannels[i] = 0;
+		voice->sendVolumes[i] = i == 0 ? 1.0f : 0.0f;
+	}
+
+	for (int i = 0; i < 6; i++)
+	{
+		voice->channelVolumes[i] = 1.0f;
+	}
+
+	voice->masterVolume = 1.0f;
+	voice->activeIndex = -1;
+	voice->pendingRouting = true;
+	envelopeInit(&voice->volumeEnvelope, true);
+	envelopeInit(&voice->modEnvelope, false);
+	lfoInit(&voice->modLfo);
+	lfoInit(&voice->vibLfo);
+	voice->lfoGain = 1.0f;
+	voice->filterCutoff = MIXER_MAX_CUTOFF;
+	voice->filterQInv = 1.0f;
+}
+
+void testSubmit(MixerVoice* voice, MixerCommandType type, int param, float value, unsigned int index)
+{
+	MixerCommand command = {};
+	command.type = type;
+	command.voice = voice;
+	command.index = index;
+	command.param = param;
+	command.value = value;
+	mixerSubmit(&command, 1);
+}
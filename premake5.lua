@@ -1,19 +1,14 @@
 workspace "Opensegaapi"
 	configurations { "Debug", "Release"}
-	platforms { "x86" }
 
-	flags { "StaticRuntime", "No64BitChecks" }
-
-	systemversion "10.0.16299.0"
+	if _TARGET_OS == "windows" then
+		platforms { "x86" }
+	else
+		platforms { "x64", "x86" }
+	end
 
 	symbols "On"
 
-	characterset "Unicode"
-
-	flags { "NoIncrementalLink", "NoEditAndContinue", "NoMinimalRebuild" }
-
-	buildoptions { "/MP", "/std:c++17" }
-
 	configuration "Debug*"
 		targetdir "build/bin/debug"
 		defines "NDEBUG"
@@ -25,7 +20,22 @@ workspace "Opensegaapi"
 		optimize "speed"
 		objdir "build/obj/release"
 
+	filter "system:windows"
+		systemversion "10.0.16299.0"
+		characterset "Unicode"
+		flags { "StaticRuntime", "No64BitChecks" }
+		flags { "NoIncrementalLink", "NoEditAndContinue", "NoMinimalRebuild" }
+		buildoptions { "/MP", "/std:c++17" }
+
+	filter "system:linux"
+		pic "On"
+		buildoptions { "-std=c++17", "-fvisibility=hidden", "-fvisibility-inlines-hidden" }
+		links { "pthread" }
+
 	filter "platforms:x86"
 		architecture "x32"
 
-include "Opensegaapi"
\ No newline at end of file
+	filter "platforms:x64"
+		architecture "x64"
+
+include "Opensegaapi"